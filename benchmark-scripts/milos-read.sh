@@ -2,26 +2,16 @@
 
 mkdir -p log/${HOST}
 
-make -B numa=1 pthread=1 avx512=1
+make -B numa=1 pthread=1
 
 fn=log/${HOST}/read-64bit
 echo "\n${fn}\n"
 echo "mbw $(git describe --all --long) $(git rev-parse HEAD)" >> ${fn}.txt
-parallel -j1 --eta --joblog ${fn}.joblog --resume --header : \
-	./mbw -a {ram_in} -b {ram_out} -c {cpu} -n 10 -N {nr_threads} -t4 4096 \
-	::: ram_in $(seq 0 17) \
-	:::+ ram_out $(seq 0 17) \
-	::: cpu $(seq 0 7) \
-	::: nr_threads $(seq 1 16) \
+./mbw -S -a 0-17 -c 0-7 -n 10 -N 1-16 -t4 4096 \
 >> ${fn}.txt
 
 fn=log/${HOST}/read-avx512
 echo "\n${fn}\n"
 echo "mbw $(git describe --all --long) $(git rev-parse HEAD)" >> ${fn}.txt
-parallel -j1 --eta --joblog ${fn}.joblog --resume --header : \
-	./mbw -a {ram_in} -b {ram_out} -c {cpu} -n 10 -N {nr_threads} -t6 4096 \
-	::: ram_in $(seq 0 17) \
-	:::+ ram_out $(seq 0 17) \
-	::: cpu $(seq 0 7) \
-	::: nr_threads $(seq 1 16) \
+./mbw -S -a 0-17 -c 0-7 -n 10 -N 1-16 -t6 4096 \
 >> ${fn}.txt
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <unistd.h>
 #include <err.h>
 #include <sys/types.h>
@@ -13,15 +14,35 @@
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
-
-#ifdef HAVE_AVX512
+#include <math.h>
+#include <sched.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+#include <sys/vfs.h>
+#include <sys/utsname.h>
+#include <linux/magic.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+
+/* SIMD kernels are compiled with per-function target attributes and
+ * selected at runtime, so one binary runs on any x86-64 CPU */
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86
 #include <immintrin.h>
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
 #endif
 
 #ifdef MULTITHREADED
 #include <pthread.h>
-#include <semaphore.h>
 #endif
 
 #ifdef NUMA
@@ -32,23 +53,53 @@
 /* how many runs to average by default */
 #define DEFAULT_NR_LOOPS 40
 
+/* default software prefetch distance, in bytes */
+#define DEFAULT_PREFETCH_DIST 512
+
 /* default block size for test 2, in bytes */
 #define DEFAULT_BLOCK_SIZE 262144
 
-/* test types */
-#define TEST_MEMCPY 0
-#define TEST_PLAIN 1
-#define TEST_MCBLOCK 2
-#define TEST_AVX512 3
-#define TEST_READ_PLAIN 4
-#define TEST_WRITE_PLAIN 5
-#define TEST_READ_AVX512 6
-#define TEST_WRITE_AVX512 7
-#define MAX_TESTS 8
+/* instruction set extensions required by a kernel */
+#define ISA_SSE2 1
+#define ISA_AVX2 2
+#define ISA_AVX512 4
+
+/* arrays read or written by a kernel */
+#define ARR_A 1
+#define ARR_B 2
+#define ARR_C 4
+
+/* scalar for the STREAM scale and triad kernels */
+#define STREAM_SCALAR 3
+
+/* kernel flags */
+#define KF_DEFAULT 1 /* run if no tests are selected */
+#define KF_SUM 2     /* returns the sum of the elements it read from arr_a */
+#define KF_ALIGN64 4 /* needs 64-byte aligned ranges (multiples of 8 elements) */
+#define KF_BLOCK 8   /* copies in chunks of block_size bytes (-B) */
+#define KF_STRIDE 16 /* accesses one element every access_stride bytes (-s) */
+#define KF_MIX 32    /* reads and writes in the mix_read:mix_write ratio (-M) */
+#define KF_PREFETCH 64 /* prefetches prefetch_dist bytes ahead (-F) */
+#define KF_FAULT 128   /* allocates and first-touches fresh memory, counts page faults */
+#define KF_NOTHP 256   /* runs with THP disabled for the process (PR_SET_THP_DISABLE) */
+
+/* transparent huge page size, used to align -H thp mappings */
+#define THP_SIZE (2*1024*1024)
+
+/* spin iterations before a waiting thread falls back to sleeping */
+#define SPIN_LIMIT 100000
 
 /* version number */
 #define VERSION "1.5+smaug"
 
+/* set by the Makefile */
+#ifndef GIT_VERSION
+#define GIT_VERSION "unknown"
+#endif
+#ifndef BUILD_CFLAGS
+#define BUILD_CFLAGS ""
+#endif
+
 /*
  * MBW memory bandwidth benchmark
  *
@@ -70,36 +121,221 @@
  * watch out for swap usage (or turn off swap)
  */
 
+/* timer backend (-r). Timestamps count nanoseconds (clock) or TSC ticks
+ * (tsc), timer_period converts them to seconds. */
+#define TIMER_CLOCK 0
+#define TIMER_TSC 1
+char const *timer_names[] = {"clock", "tsc"};
+typedef unsigned long long timestamp;
+int timer = TIMER_CLOCK;
+double timer_period = 1e-9;
+/* cost of taking a start and a stop timestamp, in seconds. Subtracted
+ * from every timed run. */
+double timer_overhead = 0;
+
 #ifdef MULTITHREADED
 unsigned long num_threads = 1;
+unsigned long max_threads = 1; /* size of the thread pool */
 volatile unsigned int done = 0;
 pthread_t *threads;
-sem_t start_sem, stop_sem, sync_sem;
+/* work other than the benchmark itself (e.g. array initialization) */
+void (*pool_job)(unsigned long thread_id) = NULL;
+
+/* hybrid barrier: active threads spin on start_gen and the main thread spins
+ * on stop_count for up to SPIN_LIMIT iterations, then they sleep on
+ * start_cond / stop_cond. Pool threads beyond num_threads sleep on idle_cond.
+ * The main thread does not spin if there are no more CPUs available to it
+ * than active threads, so that it cannot take CPU time from one of them. */
+unsigned int start_gen = 0;
+unsigned int idle_gen = 0; /* start_gen when num_threads was last changed */
+unsigned long stop_count = 0;
+unsigned int start_sleepers = 0;
+unsigned int stop_sleeping = 0;
+unsigned long main_cpus = 0; /* CPUs the main thread may run on */
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+/* per-thread timestamps of the last run, one cache line each */
+struct thread_time {
+    timestamp start, end;
+    unsigned long long load_bytes; /* moved by a load thread (-l) */
+    unsigned long long elems; /* array elements processed, over all repetitions */
+} __attribute__((aligned(64)));
+struct thread_time *thread_times;
+
+/* dynamic scheduling (-d): threads claim chunks of chunk_elems elements
+ * from a shared cursor instead of processing a fixed slice. 0 selects the
+ * static split. */
+unsigned long long chunk_elems = 0;
+struct {
+    unsigned long long next;
+    char pad[56];
+} __attribute__((aligned(64))) chunk_cursor;
+
+/* loaded latency mode (-l): while thread 0 runs a latency test, the other
+ * threads run this bandwidth test, pausing for inject_delay cpu_relax()
+ * iterations after each LOAD_CHUNK elements */
+#define LOAD_CHUNK 512
+int load_test = -1;
+unsigned long inject_delay = 0;
+unsigned int probe_done;
 #endif
 
+/* hardware performance counters (-p), counted per thread around the
+ * timed region. Members of a group that cannot be opened are skipped. */
+#define NR_COUNTERS 5
+#define CNT_CYCLES 0
+#define CNT_INSTRUCTIONS 1
+#define CNT_LLC_LOADS 2
+#define CNT_LLC_MISSES 3
+#define CNT_DTLB_MISSES 4
+#define HW_CACHE_EVENT(cache, op, result) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_ ## op << 8) | (PERF_COUNT_HW_CACHE_RESULT_ ## result << 16))
+struct counter_def {
+    char const *name;
+    unsigned int type;
+    unsigned long long config;
+} const counter_defs[NR_COUNTERS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"llc_loads", PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, READ, ACCESS)},
+    {"llc_misses", PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, READ, MISS)},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, READ, MISS)},
+};
+struct counters {
+    int opened;
+    int leader;               /* group leader fd, -1 if nothing could be opened */
+    int pos[NR_COUNTERS];     /* position in the group read, -1 if unavailable */
+    unsigned int nr;
+    int multiplexed;          /* the group was not counting for the whole run */
+    unsigned long long val[NR_COUNTERS];
+} __attribute__((aligned(64)));
+int perf_enabled = 0;
+struct counters *thread_counters = NULL;
+int counter_warned[NR_COUNTERS];
+
+/* uncore memory controller CAS counts, system wide. Each memory controller
+ * is counted on one CPU of each socket (its PMU's cpumask). Each CAS
+ * transfers one 64 byte cache line. */
+#define MAX_IMC 256
+int imc_fd[2][MAX_IMC];
+unsigned int nr_imc = 0;
+unsigned long long imc_val[2];
+int imc_multiplexed;
+
+/* print results as JSON lines instead of key=value text (-J) */
+int output_json = 0;
+
+/* sweep mode: -a/-b/-c/-N/-I/-s/-M take lists and all combinations are measured */
+int sweep = 0;
+
+/* CPU placement of threads (-P) */
+#define LAYOUT_NONE 0
+#define LAYOUT_LIST 1
+#define LAYOUT_COMPACT 2
+#define LAYOUT_SCATTER 3
+#define LAYOUT_CORES 4
+unsigned int cpu_layout = LAYOUT_NONE;
+unsigned long *cpu_list = NULL; /* explicit CPU ids for LAYOUT_LIST */
+unsigned int nr_cpu_list = 0;
+cpu_set_t cpus_allowed; /* CPUs available to the process at startup */
+int *thread_cpu = NULL; /* CPU each thread is pinned to, -1 if not pinned */
+
 long *arr_a = NULL;
 long *arr_b = NULL; /* the two arrays to be copied from/to */
+long *arr_c = NULL; /* second output array of the STREAM kernels */
 unsigned long long arr_size=0; /* array size (elements in array) */
-unsigned int test_type;
+unsigned int test_type; /* index into kernels[] */
+/* distance between accesses of the strided tests in bytes (-s) */
+unsigned long access_stride = sizeof(long);
+/* read:write ratio of the mix test in cache lines (-M) */
+unsigned long mix_read = 1, mix_write = 1;
+/* distance of the software prefetches ahead of the accesses in bytes (-F) */
+unsigned long prefetch_dist = DEFAULT_PREFETCH_DIST;
+/* page faults of the last run of a KF_FAULT test */
+unsigned long long nr_faults = 0;
 /* fixed memcpy block size for -t2 */
 unsigned long long block_size=DEFAULT_BLOCK_SIZE;
+/* kernel passes per timed sample, calibrated with -m */
+unsigned long repetitions = 1;
+
+/* data / unified cache sizes in bytes, indexed by cache level */
+#define MAX_CACHE_LEVEL 3
+unsigned long long cache_size[MAX_CACHE_LEVEL + 1];
 
 int sanity_check = 0;
 long arr_a_sum = 0;
 long *partial_sum;
 
+/* allocation backends for the test arrays (-H) */
+#define ALLOC_MALLOC 0
+#define ALLOC_THP 1
+#define ALLOC_NOTHP 2
+#define ALLOC_HUGETLB_2M 3
+#define ALLOC_HUGETLB_1G 4
+unsigned int alloc_backend = ALLOC_MALLOC;
+char const *alloc_names[] = {"malloc", "thp", "nothp", "hugetlb2m", "hugetlb1g"};
+
+/* files mapped as arr_a (-f) and arr_b (-o) instead of memory of the -H
+ * backend, e.g. on tmpfs, hugetlbfs, a page cache backed file system or
+ * a DAX device, and their mmap flags (-x) */
+char const *file_a = NULL, *file_b = NULL;
+int file_map_flags = MAP_SHARED;
+struct file_map {
+    void *addr;
+    size_t len;
+} file_maps[2];
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+/* page size and share of transparent huge pages backing arr_a / arr_b,
+ * as reported by /proc/self/smaps */
+unsigned long page_size_a = 0, page_size_b = 0;
+double thp_pct_a = 0, thp_pct_b = 0;
+
+/* NUMA placement of the arrays (-D, -L). From PLACE_LOCAL on, each
+ * thread's slice is bound separately when the arrays are populated. */
+#define PLACE_NONE 0
+#define PLACE_INTERLEAVE 1 /* whole arrays interleaved over all nodes */
+#define PLACE_LOCAL 2      /* node of the thread (-L) */
+#define PLACE_NODES 3      /* thread i uses entry i (modulo length) of place_nodes */
+#define PLACE_MATRIX 4     /* threads of CPU node c use place_nodes[(pos(c) + place_shift) % n] */
+int thread_placement = PLACE_NONE;
+/* node matrix round: each round, every CPU node streams from a different
+ * memory node, so that the whole matrix is covered with all nodes busy */
+unsigned long place_shift = 0;
+
 #ifdef NUMA
-void* mp_pages[1];
-int mp_status[1];
-int mp_nodes[1];
+/* pages queried per move_pages call */
+#define MP_BATCH 1024
+void* mp_pages[MP_BATCH];
+int mp_status[MP_BATCH];
 int numa_node_a = -1;
 int numa_node_b = -1;
 int numa_node_cpu = -1;
-struct bitmask* bitmask_a = NULL;
-struct bitmask* bitmask_b = NULL;
+/* share of the pages of arr_a / arr_b on numa_node_a / numa_node_b */
+double numa_pct_a = 0, numa_pct_b = 0;
+/* memory policy of the arrays as allocated */
+int array_policy = MPOL_BIND;
+unsigned long *place_nodes = NULL;
+unsigned int nr_place_nodes = 0;
+#ifdef MULTITHREADED
+/* nodes of each thread's CPU and slice, for the node matrix */
+int *thread_cpu_node, *thread_mem_node;
+#endif
 #endif
 
-#ifdef HAVE_AVX512
+#ifdef HAVE_X86
 
 /**
  * AVX512 implementation taken from
@@ -110,7 +346,7 @@ struct bitmask* bitmask_b = NULL;
  * Copy 16 bytes from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov16(uint8_t *dst, const uint8_t *src)
 {
 	__m128i xmm0;
@@ -123,7 +359,7 @@ rte_mov16(uint8_t *dst, const uint8_t *src)
  * Copy 32 bytes from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov32(uint8_t *dst, const uint8_t *src)
 {
 	__m256i ymm0;
@@ -136,7 +372,7 @@ rte_mov32(uint8_t *dst, const uint8_t *src)
  * Copy 64 bytes from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov64(uint8_t *dst, const uint8_t *src)
 {
 	__m512i zmm0;
@@ -149,7 +385,7 @@ rte_mov64(uint8_t *dst, const uint8_t *src)
  * Copy 128 bytes from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov128(uint8_t *dst, const uint8_t *src)
 {
 	rte_mov64(dst + 0 * 64, src + 0 * 64);
@@ -160,7 +396,7 @@ rte_mov128(uint8_t *dst, const uint8_t *src)
  * Copy 256 bytes from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov256(uint8_t *dst, const uint8_t *src)
 {
 	rte_mov64(dst + 0 * 64, src + 0 * 64);
@@ -173,7 +409,7 @@ rte_mov256(uint8_t *dst, const uint8_t *src)
  * Copy 128-byte blocks from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov128blocks(uint8_t *dst, const uint8_t *src, size_t n)
 {
 	__m512i zmm0, zmm1;
@@ -193,7 +429,7 @@ rte_mov128blocks(uint8_t *dst, const uint8_t *src, size_t n)
  * Copy 512-byte blocks from one location to another,
  * locations should not overlap.
  */
-static inline void
+static inline void TARGET_AVX512
 rte_mov512blocks(uint8_t *dst, const uint8_t *src, size_t n)
 {
 	__m512i zmm0, zmm1, zmm2, zmm3, zmm4, zmm5, zmm6, zmm7;
@@ -221,7 +457,7 @@ rte_mov512blocks(uint8_t *dst, const uint8_t *src, size_t n)
 	}
 }
 
-static inline void *
+static inline void * TARGET_AVX512
 rte_memcpy(void *dst, const void *src, size_t n)
 {
 	uintptr_t dstu = (uintptr_t)dst;
@@ -338,620 +574,3852 @@ COPY_BLOCK_128_BACK63:
 	 */
 	goto COPY_BLOCK_128_BACK63;
 }
-#endif
 
-void usage()
+/**
+ * Fill n longs at dst with streaming stores, which write whole cache
+ * lines without reading them first (no read-for-ownership).
+ * dst must be 64-byte aligned, n a multiple of 8.
+ */
+static void
+nt_fill_sse2(long *dst, size_t n)
 {
-    printf("mbw memory benchmark v%s, https://github.com/raas/mbw\n", VERSION);
-    printf("Usage: mbw [options] array_size_in_MiB\n");
-    printf("Options:\n");
-    printf("	-n: number of runs per test (0 to run forever)\n");
-    printf("	-a: Don't display average\n");
-    printf("	-C: enable sanity checks\n");
-    printf("	-t%d: memcpy test\n", TEST_MEMCPY);
-    printf("	-t%d: plain (b[i]=a[i] style) test\n", TEST_PLAIN);
-    printf("	-t%d: memcpy test with fixed block size\n", TEST_MCBLOCK);
-#ifdef HAVE_AVX512
-    printf("	-t%d: AVX512 copy test\n", TEST_AVX512);
-#endif
-    printf("	-t%d: plain read test (sum)\n", TEST_READ_PLAIN);
-    printf("	-t%d: plain write test (const fill)\n", TEST_WRITE_PLAIN);
-#ifdef HAVE_AVX512
-    printf("	-t%d: AVX512 read test (sum)\n", TEST_READ_AVX512);
-    printf("	-t%d: AVX512 write test (const fill)\n", TEST_WRITE_AVX512);
-#endif
-    printf("	-b <size>: block size in bytes for -t2 (default: %d)\n", DEFAULT_BLOCK_SIZE);
-    printf("	-q: quiet (print statistics only)\n");
-#ifdef NUMA
-    printf("	-a <node>: allocate source array on NUMA node\n");
-    printf("	-b <node>: allocate target array on NUMA node\n");
-    printf("	-c <node>: schedule task/threads on NUME node\n");
-#endif
-    printf("(will then use two arrays, watch out for swapping)\n");
-    printf("'Bandwidth' is amount of data copied over the time this operation took.\n");
-    printf("\nThe default is to run all tests available.\n");
+	__m128i v = _mm_set1_epi64x(0x0707070707070707);
+	size_t i;
+
+	for (i = 0; i < n; i += 8) {
+		_mm_stream_si128((__m128i *)(dst + i), v);
+		_mm_stream_si128((__m128i *)(dst + i + 2), v);
+		_mm_stream_si128((__m128i *)(dst + i + 4), v);
+		_mm_stream_si128((__m128i *)(dst + i + 6), v);
+	}
+	_mm_sfence();
 }
 
-/* ------------------------------------------------------ */
+static void TARGET_AVX2
+nt_fill_avx2(long *dst, size_t n)
+{
+	__m256i v = _mm256_set1_epi64x(0x0707070707070707);
+	size_t i;
+
+	for (i = 0; i < n; i += 8) {
+		_mm256_stream_si256((__m256i *)(dst + i), v);
+		_mm256_stream_si256((__m256i *)(dst + i + 4), v);
+	}
+	_mm_sfence();
+}
 
-/* allocate a test array and fill it with data
- * so as to force Linux to _really_ allocate it */
-long *make_array(long *sum)
+static void TARGET_AVX512
+nt_fill_avx512(long *dst, size_t n)
 {
-    unsigned long long t;
-    unsigned int long_size=sizeof(long);
-    long *a;
+	__m512i v = _mm512_set1_epi64(0x0707070707070707);
+	size_t i;
 
-#ifdef HAVE_AVX512
-    a=aligned_alloc(64, arr_size * long_size);
-#else
-    a=calloc(arr_size, long_size);
-#endif
+	for (i = 0; i < n; i += 8)
+		_mm512_stream_si512((void *)(dst + i), v);
+	_mm_sfence();
+}
 
-    if(NULL==a) {
-        perror("Error allocating memory");
-        exit(1);
-    }
+/**
+ * Copy n longs from src to dst using streaming stores.
+ * Both must be 64-byte aligned, n a multiple of 8.
+ */
+static void
+nt_copy_sse2(long *dst, const long *src, size_t n)
+{
+	size_t i;
 
-    /* make sure both arrays are allocated, fill with pattern */
-    for(t=0; t<arr_size; t++) {
-        a[t]=0xaa;
-    }
-    if (sum != NULL) {
-        *sum = 0;
-        for(t=0; t<arr_size; t++) {
-            *sum += 0xaa;
-        }
-    }
-    return a;
+	for (i = 0; i < n; i += 8) {
+		__m128i xmm0 = _mm_load_si128((const __m128i *)(src + i));
+		__m128i xmm1 = _mm_load_si128((const __m128i *)(src + i + 2));
+		__m128i xmm2 = _mm_load_si128((const __m128i *)(src + i + 4));
+		__m128i xmm3 = _mm_load_si128((const __m128i *)(src + i + 6));
+		_mm_stream_si128((__m128i *)(dst + i), xmm0);
+		_mm_stream_si128((__m128i *)(dst + i + 2), xmm1);
+		_mm_stream_si128((__m128i *)(dst + i + 4), xmm2);
+		_mm_stream_si128((__m128i *)(dst + i + 6), xmm3);
+	}
+	_mm_sfence();
 }
 
-#ifdef MULTITHREADED
-void *thread_worker(void *arg)
+static void TARGET_AVX2
+nt_copy_avx2(long *dst, const long *src, size_t n)
 {
-    unsigned long thread_id = (unsigned long)arg;
-    unsigned int long_size=sizeof(long);
-    unsigned long long array_bytes=arr_size*long_size;
-    unsigned long long t;
-    unsigned long long const plain_start = thread_id * (arr_size / num_threads);
-    unsigned long long const plain_stop = (thread_id + 1) * (arr_size / num_threads);
+	size_t i;
 
-    while (!done) {
-        if (sem_wait(&start_sem) != 0) {
-            err(1, "sem_wait(start_sem)");
-        }
-        if (done) {
-            return NULL;
-        }
-        if(test_type==TEST_MEMCPY) { /* memcpy test */
-            memcpy(arr_b + (thread_id * (arr_size / num_threads)), arr_a + (thread_id * (arr_size / num_threads)), array_bytes / num_threads);
-        } else if(test_type==TEST_MCBLOCK) { /* memcpy block test */
-            char* src = (char*)(arr_a + (thread_id * (arr_size / num_threads)));
-            char* dst = (char*)(arr_b + (thread_id * (arr_size / num_threads)));
-            for (t=array_bytes / num_threads; t >= block_size; t-=block_size, src+=block_size){
-                dst=(char *) memcpy(dst, src, block_size) + block_size;
-            }
-            if(t) {
-                dst=(char *) memcpy(dst, src, t) + t;
-            }
-        } else if(test_type==TEST_PLAIN) { /* plain test */
-            for(t=plain_start; t<plain_stop; t++) {
-                arr_b[t]=arr_a[t];
-            }
-#ifdef HAVE_AVX512
-        } else if(test_type==TEST_AVX512) {
-            rte_memcpy(arr_b, arr_a, array_bytes);
-#endif // HAVE_AVX512
-        } else if(test_type==TEST_READ_PLAIN) {
-            long tmp = 0;
-            for(t=plain_start; t<plain_stop; t++) {
-                tmp += arr_a[t];
-            }
-            if (sanity_check) {
-                partial_sum[thread_id] = tmp;
-            }
-        } else if(test_type==TEST_WRITE_PLAIN) {
-            long tmp = 1374181804651713298;
-            for(t=plain_start; t<plain_stop; t++) {
-                arr_b[t] = tmp;
-            }
-#ifdef HAVE_AVX512
-        } else if(test_type==TEST_READ_AVX512) {
-            __m512i zmm0 = _mm512_setzero_epi32();
-            __m512i zmm1;
-            uint8_t *src = (uint8_t*)(arr_a + (plain_start & ~0x0000000000000007));
-            const uint8_t *end = (uint8_t*)(arr_a + (plain_stop & ~0x0000000000000007));
-            long tmp = 0;
-            while (src < end) {
-                zmm1 = _mm512_load_si512((const void *)src);
-                zmm0 = _mm512_add_epi64(zmm0, zmm1);
-                src += 64;
-            }
-            tmp += (long)_mm512_reduce_add_epi64(zmm0);
-            if (sanity_check) {
-                partial_sum[thread_id] = tmp;
-            }
-        } else if(test_type==TEST_WRITE_AVX512) {
-            const long src = 0x0707070707070707;
-            uint8_t *dst = (uint8_t*)(arr_b + (plain_start & ~0x0000000000000007));
-            const uint8_t *end = (uint8_t*)(arr_b + (plain_stop & ~0x0000000000000007));
-            __m512i zmm0 = _mm512_load_si512(&src);
-            while (dst < end) {
-                _mm512_store_si512((void*)(dst), zmm0);
-                dst += 64;
-            }
-#endif // HAVE_AVX512
-        }
-        if (sem_post(&stop_sem) != 0) {
-            err(1, "sem_post(stop_sem)");
-        }
-        if (sem_wait(&sync_sem) != 0) {
-            err(1, "sem_wait(sync_sem)");
-        }
-    }
-    return NULL;
+	for (i = 0; i < n; i += 8) {
+		__m256i ymm0 = _mm256_load_si256((const __m256i *)(src + i));
+		__m256i ymm1 = _mm256_load_si256((const __m256i *)(src + i + 4));
+		_mm256_stream_si256((__m256i *)(dst + i), ymm0);
+		_mm256_stream_si256((__m256i *)(dst + i + 4), ymm1);
+	}
+	_mm_sfence();
 }
 
-void start_threads()
+static void TARGET_AVX512
+nt_copy_avx512(long *dst, const long *src, size_t n)
 {
-    for (unsigned int i = 0 ; i < num_threads; i++) {
-        sem_post(&start_sem);
-    }
+	size_t i;
+
+	for (i = 0; i < n; i += 8)
+		_mm512_stream_si512((void *)(dst + i), _mm512_load_si512((const void *)(src + i)));
+	_mm_sfence();
 }
+#endif // HAVE_X86
 
-void await_threads()
+/* ------------------------------------------------------ */
+
+/* benchmark kernels: each one processes the elements [start, stop) of the
+ * test arrays once. The multithreaded build calls them with each thread's
+ * share of the arrays. */
+
+long kernel_memcpy(unsigned long long start, unsigned long long stop)
 {
-    for (unsigned int i = 0 ; i < num_threads; i++) {
-        sem_wait(&stop_sem);
-    }
+    memcpy(arr_b + start, arr_a + start, (stop - start) * sizeof(long));
+    return 0;
 }
 
-void sync_threads()
+long kernel_plain(unsigned long long start, unsigned long long stop)
 {
-    for (unsigned int i = 0 ; i < num_threads; i++) {
-        sem_post(&sync_sem);
+    for (unsigned long long t = start; t < stop; t++) {
+        arr_b[t] = arr_a[t];
     }
+    return 0;
 }
-#endif
 
-/* actual benchmark */
-/* arr_size: number of type 'long' elements in test arrays
- * long_size: sizeof(long) cached
- * test_type: 0=use memcpy, 1=use plain copy loop (whatever GCC thinks best)
- *
- * return value: elapsed time in seconds
- */
-double worker()
+long kernel_mcblock(unsigned long long start, unsigned long long stop)
 {
-    struct timespec starttime, endtime;
-    double te;
-    /* array size in bytes */
-
-#ifdef MULTITHREADED
-    clock_gettime(CLOCK_MONOTONIC, &starttime);
-    start_threads();
-    await_threads();
-    clock_gettime(CLOCK_MONOTONIC, &endtime);
-    sync_threads();
-#else
-
-    unsigned int long_size=sizeof(long);
-    unsigned long long array_bytes=arr_size*long_size;
     unsigned long long t;
-    if(test_type==TEST_MEMCPY) { /* memcpy test */
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        memcpy(arr_b, arr_a, array_bytes);
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-    } else if(test_type==TEST_MCBLOCK) { /* memcpy block test */
-        char* src = (char*)arr_a;
-        char* dst = (char*)arr_b;
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        for (t=array_bytes; t >= block_size; t-=block_size, src+=block_size){
-            dst=(char *) memcpy(dst, src, block_size) + block_size;
-        }
-        if(t) {
-            dst=(char *) memcpy(dst, src, t) + t;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-    } else if(test_type==TEST_PLAIN) { /* plain test */
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        for(t=0; t<arr_size; t++) {
-            arr_b[t]=arr_a[t];
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-#ifdef HAVE_AVX512
-    } else if(test_type==TEST_AVX512) {
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        rte_memcpy(arr_b, arr_a, array_bytes);
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-#endif // HAVE_AVX512
-    } else if(test_type==TEST_READ_PLAIN) {
-        long tmp = 0;
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        for(t=0; t<arr_size; t++) {
-            tmp += arr_a[t];
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-        if (sanity_check) {
-            assert(tmp == arr_a_sum);
-        }
-    } else if(test_type==TEST_WRITE_PLAIN) {
-        long tmp = 0;
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        for(t=0; t<arr_size; t++) {
-            arr_b[t] = ++tmp;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-#ifdef HAVE_AVX512
-    } else if(test_type==TEST_READ_AVX512) {
-        __m512i zmm0 = _mm512_setzero_epi32();
-        __m512i zmm1;
-        long tmp = 0;
-        uint8_t *src = (uint8_t*)arr_a;
-        const uint8_t *end = src + arr_size * sizeof(long);
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        while (src < end) {
-            zmm1 = _mm512_load_si512((const void *)src);
-            zmm0 = _mm512_add_epi64(zmm0, zmm1);
-            src += 64;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-        tmp = (long)_mm512_reduce_add_epi64(zmm0);
-        if (sanity_check) {
-            if (tmp != arr_a_sum) {
-                printf("expected: arr_a_sum == %12ld (%016lx)\n", arr_a_sum, arr_a_sum);
-                printf("output:  reduce_add == %12ld (%016lx)\n", tmp, tmp);
-            }
-            assert(tmp == arr_a_sum);
-        }
-    } else if(test_type==TEST_WRITE_AVX512) {
-        const uint8_t *src = (uint8_t*)arr_b;
-        uint8_t *dst = (uint8_t*)arr_b;
-        const uint8_t *end = dst + arr_size * sizeof(long);
-        __m512i zmm0 = _mm512_load_si512(src);
-        clock_gettime(CLOCK_MONOTONIC, &starttime);
-        while (dst < end) {
-            _mm512_store_si512((void*)(dst), zmm0);
-            dst += 64;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &endtime);
-#endif // HAVE_AVX512
+    char* src = (char*)(arr_a + start);
+    char* dst = (char*)(arr_b + start);
+
+    for (t=(stop - start) * sizeof(long); t >= block_size; t-=block_size, src+=block_size){
+        dst=(char *) memcpy(dst, src, block_size) + block_size;
     }
-#endif // !MULTITHREADED
+    if(t) {
+        dst=(char *) memcpy(dst, src, t) + t;
+    }
+    return 0;
+}
 
-    te=((double)(endtime.tv_sec*1000000000-starttime.tv_sec*1000000000+endtime.tv_nsec-starttime.tv_nsec))/1000000000;
+long kernel_read(unsigned long long start, unsigned long long stop)
+{
+    long tmp = 0;
 
-    return te;
+    for (unsigned long long t = start; t < stop; t++) {
+        tmp += arr_a[t];
+    }
+    return tmp;
 }
 
-/* ------------------------------------------------------ */
-
-/* pretty print worker's output in human-readable terms */
-/* te: elapsed time in seconds
- * mt: amount of transferred data in MiB
- * test_type: see 'worker' above
- *
- * return value: -
- */
-void printout(double te, double mt)
+long kernel_write(unsigned long long start, unsigned long long stop)
 {
-    switch(test_type) {
-        case TEST_MEMCPY:
-            printf("e_method=MEMCPY ");
-            break;
-        case TEST_PLAIN:
-            printf("e_method=PLAIN ");
-            break;
-        case TEST_MCBLOCK:
-            printf("e_method=MCBLOCK ");
-            break;
+    long const tmp = 1374181804651713298;
+
+    for (unsigned long long t = start; t < stop; t++) {
+        arr_b[t] = tmp;
     }
-    printf("| data_MiB=%f time_s=%f throughput_MiBps=%f\n", mt, te, mt/te);
-    return;
+    return 0;
 }
 
-/* ------------------------------------------------------ */
+/* pointer chasing latency tests: every chain link holds the address of
+ * the next one, so each load depends on the previous one. The links are
+ * visited in random order to defeat the hardware prefetchers. */
+#define CHASE_LINE 64
+#define CHASE_PAGE 4096
 
-int main(int argc, char **argv)
+/* number of chain links in the elements [start, stop) */
+unsigned long long chase_links(unsigned long long start, unsigned long long stop, unsigned int stride)
 {
-    unsigned int long_size=0;
-    double te, te_sum; /* time elapsed */
-    unsigned int i;
-    int o; /* getopt options */
-    unsigned long testno;
+    return (stop - start) * sizeof(long) / stride;
+}
 
-    /* options */
+/* exit unless each thread's slice of an array of size bytes, split as by
+ * thread_range, holds at least one chain link. A thread without links
+ * would report infinite latency. */
+void check_chase_size(char const *name, unsigned long long size, unsigned long threads, unsigned int stride)
+{
+    unsigned long long const end = size / sizeof(long) & ~7ULL;
 
-    /* how many runs to average? */
-    unsigned int nr_loops=DEFAULT_NR_LOOPS;
-    /* what tests to run (-t x) */
-    int tests[MAX_TESTS];
-    double mt=0; /* MiBytes transferred == array size in MiB */
-    int quiet=0; /* suppress extra messages */
+    for (unsigned long i = 0; i < threads; i++) {
+        unsigned long long start = end * i / threads & ~7ULL;
+        unsigned long long stop = end * (i + 1) / threads & ~7ULL;
+        if (chase_links(start, stop, stride) == 0) {
+            printf("Error: array size %llu B is too small for %s with %lu thread(s), "
+                    "each thread needs at least %u B\n", size, name, threads, stride);
+            exit(1);
+        }
+    }
+}
 
-    tests[0]=0;
-    tests[1]=0;
-    tests[2]=0;
-    tests[3]=0;
-    tests[4]=0;
-    tests[5]=0;
-    tests[6]=0;
-    tests[7]=0;
+/* element offset of chain link i. Links a page apart use a different
+ * cache line in each page so that they do not all map to the same cache
+ * sets. */
+static inline unsigned long long chase_index(unsigned long long i, unsigned int stride)
+{
+    unsigned long long idx = i * (stride / sizeof(long));
 
-    while((o=getopt(argc, argv, "ha:b:c:qn:N:t:B:C")) != EOF) {
-        switch(o) {
-            case 'h':
-                usage();
-                exit(1);
-                break;
-#ifdef NUMA
-            case 'a': /* NUMA node */
-                bitmask_a = numa_parse_nodestring(optarg);
-                break;
-            case 'b': /* NUMA node */
-                bitmask_b = numa_parse_nodestring(optarg);
-                break;
-            case 'c': /* NUMA node */
-                numa_node_cpu = strtoul(optarg, (char **)NULL, 10);
-                break;
-#endif
-            case 'n': /* no. loops */
-                nr_loops=strtoul(optarg, (char **)NULL, 10);
-                break;
-#ifdef MULTITHREADED
-            case 'N': /* no. threads */
-                num_threads=strtoul(optarg, (char **)NULL, 10);
-                break;
-#endif
-            case 't': /* test to run */
-                testno=strtoul(optarg, (char **)NULL, 10);
-                if(testno>MAX_TESTS-1) {
-                    printf("Error: test number must be between 0 and %d\n", MAX_TESTS-1);
-                    exit(1);
-                }
-                tests[testno]=1;
-                break;
-            case 'B': /* block size in bytes*/
-                block_size=strtoull(optarg, (char **)NULL, 10);
-                if(0>=block_size) {
-                    printf("Error: what block size do you mean?\n");
-                    exit(1);
-                }
-                break;
-            case 'C':
-                sanity_check = 1;
-                break;
-            case 'q': /* quiet */
-                quiet=1;
-                break;
-            default:
-                break;
-        }
+    if (stride > CHASE_LINE) {
+        idx += (i % (stride / CHASE_LINE)) * (CHASE_LINE / sizeof(long));
     }
+    return idx;
+}
 
-#ifndef HAVE_AVX512
-    if (tests[TEST_AVX512]) {
-        printf("Error: AVX512 memcpy requested, but this mbw build has been compiled without AVX512 support\n");
-        exit(1);
+/* build a random cyclic chain through all links in [start, stop) of
+ * arr_a, starting and ending at arr_a[start] */
+void chase_setup(unsigned long long start, unsigned long long stop, unsigned int stride)
+{
+    long *base = arr_a + start;
+    unsigned long long const n = chase_links(start, stop, stride);
+    unsigned long long i, j;
+    uint64_t rnd = 0x9e3779b97f4a7c15ULL ^ start;
+    long tmp;
+
+    for (i = 0; i < n; i++) {
+        base[chase_index(i, stride)] = i;
     }
-    if (tests[TEST_READ_AVX512]) {
-        printf("Error: AVX512 read requested, but this mbw build has been compiled without AVX512 support\n");
-        exit(1);
+    /* Sattolo's algorithm yields a permutation with a single cycle */
+    for (i = n - 1; n && i > 0; i--) {
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 7;
+        rnd ^= rnd << 17;
+        j = rnd % i;
+        tmp = base[chase_index(i, stride)];
+        base[chase_index(i, stride)] = base[chase_index(j, stride)];
+        base[chase_index(j, stride)] = tmp;
     }
-    if (tests[TEST_WRITE_AVX512]) {
-        printf("Error: AVX512 write requested, but this mbw build has been compiled without AVX512 support\n");
-        exit(1);
+    for (i = 0; i < n; i++) {
+        base[chase_index(i, stride)] = (long)(base + chase_index(base[chase_index(i, stride)], stride));
     }
-#endif
+}
 
-    /* default is to run most tests if no specific tests were requested */
-    if( (tests[0]+tests[1]+tests[2]+tests[3]+tests[4]+tests[5]+tests[6]+tests[7]) == 0) {
-        tests[0]=1;
-        tests[1]=1;
-        tests[2]=1;
-        tests[4]=1;
-        tests[5]=1;
-#if HAVE_AVX512
-        tests[3]=1;
-        tests[6]=1;
-        tests[7]=1;
-#endif
-    }
+static inline long chase(unsigned long long start, unsigned long long stop, unsigned int stride)
+{
+    long *p = arr_a + start;
 
-    if( nr_loops==0 && ((tests[0]+tests[1]+tests[2]+tests[3]+tests[4]+tests[5]+tests[6]+tests[7]) != 1) ) {
-        printf("Error: nr_loops can be zero if only one test selected!\n");
-        exit(1);
+    for (unsigned long long n = chase_links(start, stop, stride); n > 0; n--) {
+        p = (long *)*p;
     }
+    return (long)p;
+}
 
-    if(optind<argc) {
-        mt=strtoul(argv[optind++], (char **)NULL, 10);
-    } else {
-        printf("Error: no array size given!\n");
-        exit(1);
-    }
+void chase_setup_line(unsigned long long start, unsigned long long stop)
+{
+    chase_setup(start, stop, CHASE_LINE);
+}
 
-    if(0>=mt) {
-        printf("Error: array size wrong!\n");
-        exit(1);
-    }
+void chase_setup_page(unsigned long long start, unsigned long long stop)
+{
+    chase_setup(start, stop, CHASE_PAGE);
+}
 
-    /* ------------------------------------------------------ */
+long kernel_latency_line(unsigned long long start, unsigned long long stop)
+{
+    return chase(start, stop, CHASE_LINE);
+}
 
-    long_size=sizeof(long); /* the size of long on this platform */
-    arr_size=1024*1024/long_size*mt; /* how many longs then in one array? */
+long kernel_latency_page(unsigned long long start, unsigned long long stop)
+{
+    return chase(start, stop, CHASE_PAGE);
+}
 
-    if(arr_size*long_size < block_size) {
-        printf("Error: array size larger than block size (%llu bytes)!\n", block_size);
-        exit(1);
-    }
+/* strided tests: like read and write, but only one element every
+ * access_stride bytes */
+long kernel_read_stride(unsigned long long start, unsigned long long stop)
+{
+    unsigned long const step = access_stride / sizeof(long);
+    long tmp = 0;
 
-    if(!quiet) {
-        printf("Long uses %d bytes. ", long_size);
-        if(tests[2]) {
-            printf("Using %lld bytes as blocks for memcpy block copy test.\n", block_size);
-        }
+    for (unsigned long long t = start; t < stop; t += step) {
+        tmp += arr_a[t];
     }
+    return tmp;
+}
 
-#ifdef NUMA
-    struct bitmask *bitmask_all = numa_allocate_nodemask();
-    numa_bitmask_setall(bitmask_all);
-    if (bitmask_a) {
-        numa_set_membind(bitmask_a);
-        numa_free_nodemask(bitmask_a);
-    }
-#endif
-    if (tests[TEST_MEMCPY]+tests[TEST_PLAIN]+tests[TEST_MCBLOCK]+tests[TEST_AVX512]+tests[TEST_READ_PLAIN]+tests[TEST_READ_AVX512]) {
-        if (!quiet) {
-            printf("Allocating %lld elements = %lld MiB of input memory.\n", arr_size, arr_size*long_size / 1024 / 1024);
-        }
-        arr_a=make_array(&arr_a_sum);
-    }
+long kernel_write_stride(unsigned long long start, unsigned long long stop)
+{
+    unsigned long const step = access_stride / sizeof(long);
+    long const tmp = 1374181804651713298;
 
-#ifdef NUMA
-    if (bitmask_b) {
-        numa_set_membind(bitmask_b);
-        numa_free_nodemask(bitmask_b);
-    }
-#endif
-    if (tests[TEST_MEMCPY]+tests[TEST_PLAIN]+tests[TEST_MCBLOCK]+tests[TEST_AVX512]+tests[TEST_WRITE_PLAIN]+tests[TEST_WRITE_AVX512]) {
-        if (!quiet) {
-            printf("Allocating %lld elements = %lld MiB of output memory.\n", arr_size, arr_size*long_size / 1024 / 1024);
-        }
-        arr_b=make_array(NULL);
+    for (unsigned long long t = start; t < stop; t += step) {
+        arr_b[t] = tmp;
     }
+    return 0;
+}
 
-#ifdef NUMA
-    numa_set_membind(bitmask_all);
-    numa_free_nodemask(bitmask_all);
-#endif
+/* read/write mix: reads mix_read cache lines of arr_a, then writes the
+ * next mix_write cache lines of arr_b, and so on. Each pass touches every
+ * line position once, so the combined traffic is one array size. */
+long kernel_mix(unsigned long long start, unsigned long long stop)
+{
+    unsigned long long const read_elems = mix_read * 8, write_elems = mix_write * 8;
+    unsigned long long t = start, end;
+    long const val = 1374181804651713298;
+    long tmp = 0;
 
-#ifdef NUMA
-    if (arr_a != NULL) {
-        mp_pages[0] = arr_a;
-        if (move_pages(0, 1, mp_pages, NULL, mp_status, 0) == -1) {
-            perror("move_pages(arr_a)");
-        }
-        else if (mp_status[0] < 0) {
-            printf("move_pages(arr_a) error: %d\n", mp_status[0]);
+    while (t < stop) {
+        end = t + read_elems < stop ? t + read_elems : stop;
+        for (; t < end; t++) {
+            tmp += arr_a[t];
         }
-        else {
-            numa_node_a = mp_status[0];
+        end = t + write_elems < stop ? t + write_elems : stop;
+        for (; t < end; t++) {
+            arr_b[t] = val;
         }
     }
+    return tmp;
+}
 
-    if (arr_b != NULL) {
-        mp_pages[0] = arr_b;
-        if (move_pages(0, 1, mp_pages, NULL, mp_status, 0) == -1) {
-            perror("move_pages(arr_b)");
+/* first touch tests: each pass allocates fresh memory for the thread's
+ * share of the array size, writes one element per base page and releases
+ * it again. In the multi-threaded build all threads contend for the
+ * mmap_lock and the page allocator. */
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/* keep the compiler from dropping stores to memory that is freed next */
+#define ESCAPE(p) __asm__ volatile("" : : "r"(p) : "memory")
+
+static inline void touch_pages(char *p, size_t bytes)
+{
+    size_t const page_size = sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; i < bytes; i += page_size) {
+        p[i] = 1;
+    }
+    ESCAPE(p);
+}
+
+/* mmap bytes of anonymous memory, THP aligned and advised with thp. With
+ * MAP_POPULATE the pages are faulted in before the advice, so callers
+ * that must not get huge pages run with KF_NOTHP. */
+static char *fault_map(size_t bytes, int flags, int thp)
+{
+    size_t slack = thp ? THP_SIZE : 0;
+    char *a, *aligned;
+
+    a = mmap(NULL, bytes + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (a == MAP_FAILED) {
+        err(1, "mmap");
+    }
+    if (slack) {
+        aligned = (char*)(((uintptr_t)a + slack - 1) & ~(uintptr_t)(slack - 1));
+        if (aligned > a) {
+            munmap(a, aligned - a);
+        }
+        munmap(aligned + bytes, a + slack - aligned);
+        a = aligned;
+    }
+    if (madvise(a, bytes, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0) {
+        err(1, "madvise");
+    }
+    return a;
+}
+
+long kernel_fault(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = fault_map(bytes, 0, 0);
+
+    touch_pages(p, bytes);
+    munmap(p, bytes);
+    return 0;
+}
+
+long kernel_fault_thp(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = fault_map(bytes, 0, 1);
+
+    touch_pages(p, bytes);
+    munmap(p, bytes);
+    return 0;
+}
+
+long kernel_fault_populate(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = fault_map(bytes, MAP_POPULATE, 0);
+
+    touch_pages(p, bytes);
+    munmap(p, bytes);
+    return 0;
+}
+
+long kernel_fault_populate_write(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = fault_map(bytes, 0, 0);
+
+    if (madvise(p, bytes, MADV_POPULATE_WRITE) != 0) {
+        err(1, "madvise(MADV_POPULATE_WRITE) (needs Linux 5.14)");
+    }
+    touch_pages(p, bytes);
+    munmap(p, bytes);
+    return 0;
+}
+
+long kernel_fault_calloc(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = calloc(1, bytes);
+
+    if (p == NULL) {
+        err(1, "calloc");
+    }
+    touch_pages(p, bytes);
+    free(p);
+    return 0;
+}
+
+long kernel_fault_memset(unsigned long long start, unsigned long long stop)
+{
+    size_t bytes = (stop - start) * sizeof(long);
+    char *p = malloc(bytes);
+
+    if (p == NULL) {
+        err(1, "malloc");
+    }
+    /* or gcc merges malloc and memset into calloc */
+    ESCAPE(p);
+    memset(p, 0, bytes);
+    ESCAPE(p);
+    free(p);
+    return 0;
+}
+
+/* random access tests: a pass makes one access per element (or cache
+ * line) in its range, at indexes drawn from a per-thread xorshift
+ * generator. With -R, all threads draw indexes from the whole array. */
+int random_shared = 0;
+static _Thread_local uint64_t rnd_state[8];
+
+/* generator state of the calling thread, seeded on first use */
+static inline uint64_t *rnd_seed(unsigned long long start)
+{
+    if (rnd_state[0] == 0) {
+        for (unsigned int i = 0; i < 8; i++) {
+            rnd_state[i] = 0x9e3779b97f4a7c15ULL * (start + i + 1);
+        }
+    }
+    return rnd_state;
+}
+
+static inline uint64_t xorshift64(uint64_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+/* first element and number of elements random indexes are drawn from.
+ * Limited to 2^32 - 1 elements so that indexes can be scaled with a
+ * 32x32 bit multiplication: idx = (rnd >> 32) * n >> 32 */
+static inline long *random_base(long *arr, unsigned long long start, unsigned long long stop, uint64_t *n)
+{
+    if (random_shared) {
+        start = 0;
+        stop = arr_size;
+    }
+    *n = stop - start < UINT32_MAX ? stop - start : UINT32_MAX;
+    return arr + start;
+}
+
+long kernel_random_read(unsigned long long start, unsigned long long stop)
+{
+    uint64_t n, *state = rnd_seed(start), x = state[0];
+    long const *base = random_base(arr_a, start, stop, &n);
+    long sum = 0;
+
+    for (unsigned long long i = start; i < stop; i++) {
+        x = xorshift64(x);
+        sum += base[((x >> 32) * n) >> 32];
+    }
+    state[0] = x;
+    return sum;
+}
+
+long kernel_random_read_line(unsigned long long start, unsigned long long stop)
+{
+    uint64_t n, *state = rnd_seed(start), x = state[0];
+    long const *base = random_base(arr_a, start, stop, &n);
+    long const *line;
+    long sum = 0;
+
+    n /= 8;
+    for (unsigned long long i = start; i < stop; i += 8) {
+        x = xorshift64(x);
+        line = base + (((x >> 32) * n) >> 32) * 8;
+        for (unsigned int j = 0; j < 8; j++) {
+            sum += line[j];
+        }
+    }
+    state[0] = x;
+    return sum;
+}
+
+/* GUPS (HPC Challenge RandomAccess): random read-modify-write updates */
+long kernel_gups(unsigned long long start, unsigned long long stop)
+{
+    uint64_t n, *state = rnd_seed(start), x = state[0];
+    long *base = random_base(arr_b, start, stop, &n);
+
+    for (unsigned long long i = start; i < stop; i++) {
+        x = xorshift64(x);
+        base[((x >> 32) * n) >> 32] ^= x;
+    }
+    state[0] = x;
+    return 0;
+}
+
+/* STREAM kernels (https://www.cs.virginia.edu/stream/). arr_a is only
+ * ever read so that its checksum stays valid for the read tests. */
+long kernel_scale(unsigned long long start, unsigned long long stop)
+{
+    for (unsigned long long t = start; t < stop; t++) {
+        arr_b[t] = STREAM_SCALAR * arr_a[t];
+    }
+    return 0;
+}
+
+long kernel_add(unsigned long long start, unsigned long long stop)
+{
+    for (unsigned long long t = start; t < stop; t++) {
+        arr_c[t] = arr_a[t] + arr_b[t];
+    }
+    return 0;
+}
+
+long kernel_triad(unsigned long long start, unsigned long long stop)
+{
+    for (unsigned long long t = start; t < stop; t++) {
+        arr_c[t] = arr_a[t] + STREAM_SCALAR * arr_b[t];
+    }
+    return 0;
+}
+
+#ifdef HAVE_X86
+TARGET_AVX512
+long kernel_copy_avx512(unsigned long long start, unsigned long long stop)
+{
+    rte_memcpy(arr_b + start, arr_a + start, (stop - start) * sizeof(long));
+    return 0;
+}
+
+TARGET_AVX512
+long kernel_read_avx512(unsigned long long start, unsigned long long stop)
+{
+    __m512i zmm0 = _mm512_setzero_epi32();
+    __m512i zmm1;
+    uint8_t *src = (uint8_t*)(arr_a + start);
+    const uint8_t *end = (uint8_t*)(arr_a + stop);
+
+    while (src < end) {
+        zmm1 = _mm512_load_si512((const void *)src);
+        zmm0 = _mm512_add_epi64(zmm0, zmm1);
+        src += 64;
+    }
+    return (long)_mm512_reduce_add_epi64(zmm0);
+}
+
+TARGET_AVX512
+long kernel_write_avx512(unsigned long long start, unsigned long long stop)
+{
+    uint8_t *dst = (uint8_t*)(arr_b + start);
+    const uint8_t *end = (uint8_t*)(arr_b + stop);
+    __m512i zmm0 = _mm512_set1_epi64(0x0707070707070707);
+
+    while (dst < end) {
+        _mm512_store_si512((void*)(dst), zmm0);
+        dst += 64;
+    }
+    return 0;
+}
+
+/* AVX2 variants for CPUs without AVX-512. Ranges are 64-byte aligned
+ * (KF_ALIGN64), the main loops handle 256 bytes per iteration. */
+TARGET_AVX2
+long kernel_copy_avx2(unsigned long long start, unsigned long long stop)
+{
+    __m256i *dst = (__m256i *)(arr_b + start);
+    const __m256i *src = (const __m256i *)(arr_a + start);
+    const __m256i *end = (const __m256i *)(arr_a + stop);
+
+    for (; src + 8 <= end; src += 8, dst += 8) {
+        __m256i ymm0 = _mm256_load_si256(src + 0);
+        __m256i ymm1 = _mm256_load_si256(src + 1);
+        __m256i ymm2 = _mm256_load_si256(src + 2);
+        __m256i ymm3 = _mm256_load_si256(src + 3);
+        __m256i ymm4 = _mm256_load_si256(src + 4);
+        __m256i ymm5 = _mm256_load_si256(src + 5);
+        __m256i ymm6 = _mm256_load_si256(src + 6);
+        __m256i ymm7 = _mm256_load_si256(src + 7);
+        _mm256_store_si256(dst + 0, ymm0);
+        _mm256_store_si256(dst + 1, ymm1);
+        _mm256_store_si256(dst + 2, ymm2);
+        _mm256_store_si256(dst + 3, ymm3);
+        _mm256_store_si256(dst + 4, ymm4);
+        _mm256_store_si256(dst + 5, ymm5);
+        _mm256_store_si256(dst + 6, ymm6);
+        _mm256_store_si256(dst + 7, ymm7);
+    }
+    for (; src < end; src++, dst++) {
+        _mm256_store_si256(dst, _mm256_load_si256(src));
+    }
+    return 0;
+}
+
+TARGET_AVX2
+long kernel_read_avx2(unsigned long long start, unsigned long long stop)
+{
+    /* independent accumulators so that the adds do not form a single
+     * dependency chain */
+    __m256i ymm0 = _mm256_setzero_si256();
+    __m256i ymm1 = _mm256_setzero_si256();
+    __m256i ymm2 = _mm256_setzero_si256();
+    __m256i ymm3 = _mm256_setzero_si256();
+    const __m256i *src = (const __m256i *)(arr_a + start);
+    const __m256i *end = (const __m256i *)(arr_a + stop);
+    __m128i xmm0;
+
+    for (; src + 8 <= end; src += 8) {
+        ymm0 = _mm256_add_epi64(ymm0, _mm256_load_si256(src + 0));
+        ymm1 = _mm256_add_epi64(ymm1, _mm256_load_si256(src + 1));
+        ymm2 = _mm256_add_epi64(ymm2, _mm256_load_si256(src + 2));
+        ymm3 = _mm256_add_epi64(ymm3, _mm256_load_si256(src + 3));
+        ymm0 = _mm256_add_epi64(ymm0, _mm256_load_si256(src + 4));
+        ymm1 = _mm256_add_epi64(ymm1, _mm256_load_si256(src + 5));
+        ymm2 = _mm256_add_epi64(ymm2, _mm256_load_si256(src + 6));
+        ymm3 = _mm256_add_epi64(ymm3, _mm256_load_si256(src + 7));
+    }
+    for (; src < end; src += 2) {
+        ymm0 = _mm256_add_epi64(ymm0, _mm256_load_si256(src + 0));
+        ymm1 = _mm256_add_epi64(ymm1, _mm256_load_si256(src + 1));
+    }
+    ymm0 = _mm256_add_epi64(_mm256_add_epi64(ymm0, ymm1), _mm256_add_epi64(ymm2, ymm3));
+    xmm0 = _mm_add_epi64(_mm256_castsi256_si128(ymm0), _mm256_extracti128_si256(ymm0, 1));
+    return _mm_cvtsi128_si64(xmm0) + _mm_extract_epi64(xmm0, 1);
+}
+
+TARGET_AVX2
+long kernel_write_avx2(unsigned long long start, unsigned long long stop)
+{
+    __m256i *dst = (__m256i *)(arr_b + start);
+    const __m256i *end = (const __m256i *)(arr_b + stop);
+    __m256i ymm0 = _mm256_set1_epi64x(0x0707070707070707);
+
+    for (; dst + 8 <= end; dst += 8) {
+        _mm256_store_si256(dst + 0, ymm0);
+        _mm256_store_si256(dst + 1, ymm0);
+        _mm256_store_si256(dst + 2, ymm0);
+        _mm256_store_si256(dst + 3, ymm0);
+        _mm256_store_si256(dst + 4, ymm0);
+        _mm256_store_si256(dst + 5, ymm0);
+        _mm256_store_si256(dst + 6, ymm0);
+        _mm256_store_si256(dst + 7, ymm0);
+    }
+    for (; dst < end; dst++) {
+        _mm256_store_si256(dst, ymm0);
+    }
+    return 0;
+}
+
+/* random gathers, with one xorshift generator per vector lane */
+TARGET_AVX2
+long kernel_gather_avx2(unsigned long long start, unsigned long long stop)
+{
+    uint64_t n, *state = rnd_seed(start);
+    long const *base = random_base(arr_a, start, stop, &n);
+    __m256i x = _mm256_loadu_si256((__m256i const *)state);
+    __m256i const vn = _mm256_set1_epi64x(n);
+    __m256i idx, ymm0 = _mm256_setzero_si256();
+    __m128i xmm0;
+
+    for (unsigned long long i = start; i < stop; i += 4) {
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 7));
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 17));
+        idx = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), vn), 32);
+        ymm0 = _mm256_add_epi64(ymm0, _mm256_i64gather_epi64((long long const *)base, idx, 8));
+    }
+    _mm256_storeu_si256((__m256i *)state, x);
+    xmm0 = _mm_add_epi64(_mm256_castsi256_si128(ymm0), _mm256_extracti128_si256(ymm0, 1));
+    return _mm_cvtsi128_si64(xmm0) + _mm_extract_epi64(xmm0, 1);
+}
+
+TARGET_AVX512
+long kernel_gather_avx512(unsigned long long start, unsigned long long stop)
+{
+    uint64_t n, *state = rnd_seed(start);
+    long const *base = random_base(arr_a, start, stop, &n);
+    __m512i x = _mm512_loadu_si512((void const *)state);
+    __m512i const vn = _mm512_set1_epi64(n);
+    __m512i idx, zmm0 = _mm512_setzero_si512();
+
+    for (unsigned long long i = start; i < stop; i += 8) {
+        x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 13));
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 7));
+        x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 17));
+        idx = _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(x, 32), vn), 32);
+        zmm0 = _mm512_add_epi64(zmm0, _mm512_i64gather_epi64(idx, (void const *)base, 8));
+    }
+    _mm512_storeu_si512((void *)state, x);
+    return (long)_mm512_reduce_add_epi64(zmm0);
+}
+
+/* software prefetch tests: read and copy one cache line per iteration
+ * and prefetch the line prefetch_dist bytes ahead of it. A distance of 0
+ * issues no prefetches, which gives the hardware prefetchers alone with
+ * the same loop. */
+static inline __attribute__((always_inline))
+long read_prefetch(unsigned long long start, unsigned long long stop, enum _mm_hint const hint)
+{
+    char const *ahead = (char const *)(arr_a + start) + prefetch_dist;
+    long tmp = 0;
+
+    for (unsigned long long t = start; t < stop; t += 8, ahead += 64) {
+        if (prefetch_dist) {
+            _mm_prefetch(ahead, hint);
+        }
+        tmp += arr_a[t] + arr_a[t + 1] + arr_a[t + 2] + arr_a[t + 3] +
+            arr_a[t + 4] + arr_a[t + 5] + arr_a[t + 6] + arr_a[t + 7];
+    }
+    return tmp;
+}
+
+long kernel_read_prefetch(unsigned long long start, unsigned long long stop)
+{
+    return read_prefetch(start, stop, _MM_HINT_T0);
+}
+
+long kernel_read_prefetch_nta(unsigned long long start, unsigned long long stop)
+{
+    return read_prefetch(start, stop, _MM_HINT_NTA);
+}
+
+/* prefetchw requests the destination line in exclusive state, so that the
+ * store does not need a second transaction for ownership. CPUs without
+ * PRFCHW execute it as a NOP. */
+static inline __attribute__((always_inline))
+long copy_prefetch(unsigned long long start, unsigned long long stop, int const write)
+{
+    char const *ahead = (char const *)(arr_a + start) + prefetch_dist;
+    char *ahead_dst = (char *)(arr_b + start) + prefetch_dist;
+
+    for (unsigned long long t = start; t < stop; t += 8, ahead += 64, ahead_dst += 64) {
+        if (prefetch_dist) {
+            _mm_prefetch(ahead, _MM_HINT_T0);
+            if (write) {
+                __builtin_prefetch(ahead_dst, 1, 3);
+            }
+        }
+        for (unsigned int i = 0; i < 8; i++) {
+            arr_b[t + i] = arr_a[t + i];
+        }
+    }
+    return 0;
+}
+
+long kernel_copy_prefetch(unsigned long long start, unsigned long long stop)
+{
+    return copy_prefetch(start, stop, 0);
+}
+
+__attribute__((target("prfchw")))
+long kernel_copy_prefetchw(unsigned long long start, unsigned long long stop)
+{
+    return copy_prefetch(start, stop, 1);
+}
+
+/* the non-temporal kernels use the widest vectors the CPU supports,
+ * see init_kernels() */
+void (*nt_fill)(long *dst, size_t n) = nt_fill_sse2;
+void (*nt_copy)(long *dst, const long *src, size_t n) = nt_copy_sse2;
+
+long kernel_write_nt(unsigned long long start, unsigned long long stop)
+{
+    nt_fill(arr_b + start, stop - start);
+    return 0;
+}
+
+long kernel_copy_nt(unsigned long long start, unsigned long long stop)
+{
+    nt_copy(arr_b + start, arr_a + start, stop - start);
+    return 0;
+}
+#endif // HAVE_X86
+
+struct kernel {
+    char const *name;   /* used in result lines and for -t */
+    char const *method; /* e_method in result lines */
+    char const *desc;
+    unsigned int isa;   /* ISA_* extensions needed */
+    unsigned int reads; /* ARR_* arrays read by one pass */
+    unsigned int writes; /* ARR_* arrays written by one pass */
+    /* data reported per pass, in multiples of the array size. The copy
+     * tests report the amount copied, the STREAM tests the sum of the
+     * arrays read and written as STREAM does. */
+    double data_factor;
+    unsigned int flags; /* KF_* */
+    long (*fn)(unsigned long long start, unsigned long long stop);
+    /* prepares the arrays for fn, called once per sweep point and thread.
+     * Kernels with a setup function leave arr_a in an undefined state. */
+    void (*setup)(unsigned long long start, unsigned long long stop);
+    unsigned int chase_stride; /* bytes between pointer chain links */
+    unsigned int random_access; /* bytes per random access */
+};
+
+#ifdef HAVE_X86
+#define X86_KERNEL(fn) fn
+#else
+#define X86_KERNEL(fn) NULL
+#endif
+
+/* all available tests. The index is the test number for -t, so new kernels
+ * go to the end. */
+struct kernel kernels[] = {
+    {"memcpy", "MEMCPY", "memcpy test", 0, ARR_A, ARR_B, 1, KF_DEFAULT, kernel_memcpy, NULL, 0, 0},
+    {"copy", "PLAIN", "plain (b[i]=a[i] style) test", 0, ARR_A, ARR_B, 1, KF_DEFAULT, kernel_plain, NULL, 0, 0},
+    {"mcblock", "MCBLOCK", "memcpy test with fixed block size", 0, ARR_A, ARR_B, 1, KF_DEFAULT | KF_BLOCK, kernel_mcblock, NULL, 0, 0},
+    {"copy-avx512", "AVX512", "AVX512 copy test", ISA_AVX512, ARR_A, ARR_B, 1, KF_DEFAULT, X86_KERNEL(kernel_copy_avx512), NULL, 0, 0},
+    {"read", "READ", "plain read test (sum)", 0, ARR_A, 0, 1, KF_DEFAULT | KF_SUM, kernel_read, NULL, 0, 0},
+    {"write", "WRITE", "plain write test (const fill)", 0, 0, ARR_B, 1, KF_DEFAULT, kernel_write, NULL, 0, 0},
+    {"read-avx512", "AVX512", "AVX512 read test (sum)", ISA_AVX512, ARR_A, 0, 1, KF_DEFAULT | KF_SUM | KF_ALIGN64, X86_KERNEL(kernel_read_avx512), NULL, 0, 0},
+    {"write-avx512", "AVX512", "AVX512 write test (const fill)", ISA_AVX512, 0, ARR_B, 1, KF_DEFAULT | KF_ALIGN64, X86_KERNEL(kernel_write_avx512), NULL, 0, 0},
+    {"write-nt", "NT128", "non-temporal write test (const fill, streaming stores)", ISA_SSE2, 0, ARR_B, 1, KF_DEFAULT | KF_ALIGN64, X86_KERNEL(kernel_write_nt), NULL, 0, 0},
+    {"copy-nt", "NT128", "non-temporal copy test (streaming stores)", ISA_SSE2, ARR_A, ARR_B, 1, KF_DEFAULT | KF_ALIGN64, X86_KERNEL(kernel_copy_nt), NULL, 0, 0},
+    {"copy-avx2", "AVX2", "AVX2 copy test", ISA_AVX2, ARR_A, ARR_B, 1, KF_DEFAULT | KF_ALIGN64, X86_KERNEL(kernel_copy_avx2), NULL, 0, 0},
+    {"read-avx2", "AVX2", "AVX2 read test (sum)", ISA_AVX2, ARR_A, 0, 1, KF_DEFAULT | KF_SUM | KF_ALIGN64, X86_KERNEL(kernel_read_avx2), NULL, 0, 0},
+    {"write-avx2", "AVX2", "AVX2 write test (const fill)", ISA_AVX2, 0, ARR_B, 1, KF_DEFAULT | KF_ALIGN64, X86_KERNEL(kernel_write_avx2), NULL, 0, 0},
+    {"scale", "STREAM", "STREAM scale test (b[i]=s*a[i])", 0, ARR_A, ARR_B, 2, 0, kernel_scale, NULL, 0, 0},
+    {"add", "STREAM", "STREAM add test (c[i]=a[i]+b[i])", 0, ARR_A | ARR_B, ARR_C, 3, 0, kernel_add, NULL, 0, 0},
+    {"triad", "STREAM", "STREAM triad test (c[i]=a[i]+s*b[i])", 0, ARR_A | ARR_B, ARR_C, 3, 0, kernel_triad, NULL, 0, 0},
+    {"latency", "CHASE", "pointer chasing latency test, one load per cache line", 0, ARR_A, 0, 1, KF_ALIGN64, kernel_latency_line, chase_setup_line, CHASE_LINE, 0},
+    {"latency-page", "CHASE", "pointer chasing latency test, one load per page", 0, ARR_A, 0, (double)CHASE_LINE / CHASE_PAGE, KF_ALIGN64, kernel_latency_page, chase_setup_page, CHASE_PAGE, 0},
+    {"random-read", "RANDOM", "random read test (sum of random 8 byte elements)", 0, ARR_A, 0, 1, KF_ALIGN64, kernel_random_read, NULL, 0, sizeof(long)},
+    {"random-read-line", "RANDOM", "random read test (sum of random 64 byte cache lines)", 0, ARR_A, 0, 1, KF_ALIGN64, kernel_random_read_line, NULL, 0, 64},
+    {"gups", "RANDOM", "random read-modify-write test (GUPS)", 0, ARR_B, ARR_B, 1, KF_ALIGN64, kernel_gups, NULL, 0, sizeof(long)},
+    {"gather-avx2", "AVX2", "AVX2 random gather test (sum)", ISA_AVX2, ARR_A, 0, 1, KF_ALIGN64, X86_KERNEL(kernel_gather_avx2), NULL, 0, sizeof(long)},
+    {"gather-avx512", "AVX512", "AVX512 random gather test (sum)", ISA_AVX512, ARR_A, 0, 1, KF_ALIGN64, X86_KERNEL(kernel_gather_avx512), NULL, 0, sizeof(long)},
+    {"read-stride", "STRIDE", "strided read test (sum of one element every -s bytes)", 0, ARR_A, 0, 1, KF_STRIDE, kernel_read_stride, NULL, 0, 0},
+    {"write-stride", "STRIDE", "strided write test (const fill of one element every -s bytes)", 0, 0, ARR_B, 1, KF_STRIDE, kernel_write_stride, NULL, 0, 0},
+    {"mix", "MIX", "read/write mix test (read:write ratio in cache lines set with -M)", 0, ARR_A, ARR_B, 1, KF_ALIGN64 | KF_MIX, kernel_mix, NULL, 0, 0},
+    {"read-prefetch", "PREFETCH", "read test with prefetcht0 -F bytes ahead (sum)", ISA_SSE2, ARR_A, 0, 1, KF_SUM | KF_ALIGN64 | KF_PREFETCH, X86_KERNEL(kernel_read_prefetch), NULL, 0, 0},
+    {"read-prefetch-nta", "PREFETCH", "read test with prefetchnta -F bytes ahead (sum)", ISA_SSE2, ARR_A, 0, 1, KF_SUM | KF_ALIGN64 | KF_PREFETCH, X86_KERNEL(kernel_read_prefetch_nta), NULL, 0, 0},
+    {"copy-prefetch", "PREFETCH", "copy test with prefetcht0 of the source -F bytes ahead", ISA_SSE2, ARR_A, ARR_B, 1, KF_ALIGN64 | KF_PREFETCH, X86_KERNEL(kernel_copy_prefetch), NULL, 0, 0},
+    {"copy-prefetchw", "PREFETCH", "copy test with prefetcht0 of the source and prefetchw of the target -F bytes ahead", ISA_SSE2, ARR_A, ARR_B, 1, KF_ALIGN64 | KF_PREFETCH, X86_KERNEL(kernel_copy_prefetchw), NULL, 0, 0},
+    {"fault", "FAULT", "first touch of fresh 4 KiB pages (mmap, write each page, munmap)", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT, kernel_fault, NULL, 0, 0},
+    {"fault-thp", "FAULT", "first touch of fresh transparent huge pages (mmap + MADV_HUGEPAGE)", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT, kernel_fault_thp, NULL, 0, 0},
+    {"fault-populate", "FAULT", "fresh 4 KiB pages prefaulted with MAP_POPULATE", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT | KF_NOTHP, kernel_fault_populate, NULL, 0, 0},
+    {"fault-populate-write", "FAULT", "fresh 4 KiB pages prefaulted with MADV_POPULATE_WRITE", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT, kernel_fault_populate_write, NULL, 0, 0},
+    {"fault-calloc", "FAULT", "calloc, write each page, free", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT, kernel_fault_calloc, NULL, 0, 0},
+    {"fault-memset", "FAULT", "malloc, memset, free", 0, 0, 0, 1, KF_ALIGN64 | KF_FAULT, kernel_fault_memset, NULL, 0, 0},
+};
+#define NR_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/* ISA_* extensions supported by this CPU */
+unsigned int isa_supported = 0;
+
+char const *isa_name(unsigned int isa)
+{
+    if (isa & ISA_AVX512) {
+        return "avx512f";
+    }
+    if (isa & ISA_AVX2) {
+        return "avx2";
+    }
+    if (isa & ISA_SSE2) {
+        return "sse2";
+    }
+    return "none";
+}
+
+/* detect CPU features and pick kernel variants accordingly */
+void init_kernels()
+{
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        isa_supported |= ISA_SSE2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        isa_supported |= ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        isa_supported |= ISA_AVX512;
+    }
+
+    char const *nt_method = NULL;
+    if (isa_supported & ISA_AVX512) {
+        nt_fill = nt_fill_avx512;
+        nt_copy = nt_copy_avx512;
+        nt_method = "NT512";
+    } else if (isa_supported & ISA_AVX2) {
+        nt_fill = nt_fill_avx2;
+        nt_copy = nt_copy_avx2;
+        nt_method = "NT256";
+    }
+    for (unsigned int i = 0; nt_method && i < NR_KERNELS; i++) {
+        if (kernels[i].fn == kernel_write_nt || kernels[i].fn == kernel_copy_nt) {
+            kernels[i].method = nt_method;
+        }
+    }
+#endif
+}
+
+int kernel_available(struct kernel const *k)
+{
+    return k->fn != NULL && (k->isa & isa_supported) == k->isa;
+}
+
+/* list all kernels along with their availability on this CPU */
+void list_kernels()
+{
+    for (unsigned int i = 0; i < NR_KERNELS; i++) {
+        printf("	-t%d, -t%s: %s", i, kernels[i].name, kernels[i].desc);
+        if (kernels[i].fn == NULL) {
+            printf(" (unavailable on this architecture)");
+        } else if (!kernel_available(&kernels[i])) {
+            printf(" (unavailable: CPU lacks %s)", isa_name(kernels[i].isa & ~isa_supported));
+        }
+        printf("\n");
+    }
+}
+
+/* look up a kernel by number or name, -1 if there is no such kernel */
+int find_kernel(char const *str)
+{
+    char *end;
+    unsigned long testno = strtoul(str, &end, 10);
+
+    if (end != str && *end == '\0') {
+        return testno < NR_KERNELS ? (int)testno : -1;
+    }
+    for (unsigned int i = 0; i < NR_KERNELS; i++) {
+        if (!strcmp(str, kernels[i].name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* look up a kernel for -t or -l, exit if it cannot run on this CPU */
+int select_kernel(char const *str)
+{
+    int testno = find_kernel(str);
+
+    if(testno<0) {
+        printf("Error: unknown test '%s', valid tests are:\n", str);
+        list_kernels();
+        exit(1);
+    }
+    if(kernels[testno].fn == NULL) {
+        printf("Error: %s test requested, but it is not available on this architecture\n", kernels[testno].name);
+        exit(1);
+    }
+    if(!kernel_available(&kernels[testno])) {
+        printf("Error: %s test requested, but this CPU does not support %s\n", kernels[testno].name, isa_name(kernels[testno].isa & ~isa_supported));
+        exit(1);
+    }
+    return testno;
+}
+
+void usage()
+{
+    printf("mbw memory benchmark v%s, https://github.com/raas/mbw\n", VERSION);
+    printf("Usage: mbw [options] array_size [array_size ...]\n");
+    printf("Options:\n");
+    printf("	-n: number of runs per test (0 to run forever), the maximum with -E\n");
+    printf("	-E <pct>: stop once the 95%% confidence interval of the mean throughput\n");
+    printf("	    is within this many percent of the mean\n");
+    printf("	-k <count>: minimum number of runs per test with -E (default: 3)\n");
+    printf("	-T <seconds>: stop each test after this much time\n");
+    printf("	-w <count>: untimed warm-up runs per test (default: 1)\n");
+    printf("	-A: don't display the summary statistics of each test\n");
+    printf("	-O <k>: drop samples more than k median absolute deviations from the\n");
+    printf("	    median from the summary statistics (default: keep all)\n");
+    printf("	-C: enable sanity checks\n");
+    printf("	-t <test>: run test by number or name (default: all available):\n");
+    list_kernels();
+    printf("	-B <size>: block size in bytes for -t2 (default: %d)\n", DEFAULT_BLOCK_SIZE);
+    printf("	-s <bytes>: distance between accesses of the strided tests (default: %d)\n", (int)sizeof(long));
+    printf("	-F <bytes>: distance of the software prefetches of the prefetch tests\n");
+    printf("	    (default: %d, 0 disables them)\n", DEFAULT_PREFETCH_DIST);
+    printf("	-M <r:w>: read:write ratio of the mix test in cache lines (default: 1:1)\n");
+    printf("	-m <ms>: repeat each test's kernel so that a sample takes at least this long\n");
+    printf("	-q: quiet (print statistics only)\n");
+    printf("	-p: count cycles, instructions, LLC and DTLB events per run with perf_event_open,\n");
+    printf("	    and memory controller traffic where the uncore PMU is accessible\n");
+    printf("	-r <timer>: time runs with clock (CLOCK_MONOTONIC, default) or tsc (rdtsc/rdtscp,\n");
+    printf("	    calibrated against CLOCK_MONOTONIC, adds B_per_cycle in TSC cycles)\n");
+    printf("	-J: print results as JSON lines, preceded by a record describing host and build\n");
+#ifdef NUMA
+    printf("	-a <node>: allocate source array on NUMA node\n");
+    printf("	-b <node>: allocate target arrays on NUMA node\n");
+    printf("	-c <node>: schedule task/threads on NUME node\n");
+    printf("	-D interleave: interleave the pages of all arrays over all NUMA nodes\n");
+#ifdef MULTITHREADED
+    printf("	-D <nodes>: bind thread i's share of the arrays to the i-th node of the list\n");
+    printf("	-D local, -L: bind each thread's share of the arrays to the thread's NUMA node\n");
+    printf("	    (combine with -P so that threads do not migrate)\n");
+    printf("	-D matrix: measure the node x node bandwidth matrix with all nodes active:\n");
+    printf("	    threads are scattered over the nodes (-P) and in round r the threads of\n");
+    printf("	    node c use memory on node c+r; one 'matrix' record per node and sample\n");
+#endif
+#endif
+#ifdef MULTITHREADED
+    printf("	-N <count>: number of threads\n");
+    printf("	-l <test>: loaded latency: threads 1 to N-1 run this bandwidth test while\n");
+    printf("	    thread 0 runs the latency tests (default: -t latency)\n");
+    printf("	-I <delay>: pause for this many spin loop iterations after each %d bytes\n", LOAD_CHUNK * (int)sizeof(long));
+    printf("	    of load traffic (default: 0). Sweep it with -S to get a latency/bandwidth curve\n");
+    printf("	-d <bytes>: dynamic scheduling: threads claim chunks of this size from a shared\n");
+    printf("	    cursor instead of processing a fixed slice (default: 0, static split)\n");
+    printf("	-R: random access tests draw indexes from the whole array instead of\n");
+    printf("	    each thread's share\n");
+#endif
+    printf("	-H <backend>: allocate arrays with malloc (default), thp (mmap + MADV_HUGEPAGE),\n");
+    printf("	    nothp (mmap + MADV_NOHUGEPAGE), hugetlb2m or hugetlb1g (MAP_HUGETLB)\n");
+    printf("	-f <path>, -o <path>: map this file as the input / output array instead, e.g. on\n");
+    printf("	    /dev/shm, hugetlbfs, a page cache backed file system or a DAX device.\n");
+    printf("	    Regular files are extended to the array size. With a shared mapping the\n");
+    printf("	    file contents are overwritten\n");
+    printf("	-x <flags>: mmap flags of -f and -o: shared (default) or private, and\n");
+    printf("	    optionally populate (MAP_POPULATE), e.g. -x private,populate\n");
+    printf("	-P <layout>: pin threads to CPUs: compact, scatter (across sockets),\n");
+    printf("	    cores (one per physical core, no SMT) or a list of CPU ids\n");
+    printf("	-S: sweep mode: -a, -b, -c, -N, -I, -d, -s, -M and -F take lists (e.g. 0-3,8 or 1-16:2),\n");
+    printf("	    all combinations are measured without reallocating the arrays\n");
+    printf("Array sizes accept k/M/G suffixes (default: MiB) and may be given as lists.\n");
+    printf("A range such as 4k-1G is a log2 grid, 4k-1G:4 uses four points per doubling.\n");
+    printf("(will then use two arrays, watch out for swapping)\n");
+    printf("'Bandwidth' is amount of data copied over the time this operation took.\n");
+    printf("\nThe default is to run all tests available.\n");
+}
+
+/* ------------------------------------------------------ */
+
+/* parse a comma-separated list of numbers and ranges such as "0-3,8,16-32:8"
+ * (from-to[:step]) into a newly allocated array
+ *
+ * return value: number of list entries
+ */
+unsigned int parse_list(char const *str, unsigned long **list)
+{
+    unsigned long *ret = NULL;
+    unsigned int n = 0;
+    unsigned long from, to, step;
+    char const *pos = str;
+    char *end;
+
+    while (*pos) {
+        from = strtoul(pos, &end, 10);
+        if (end == pos) {
+            printf("Error: cannot parse list '%s'\n", str);
+            exit(1);
+        }
+        to = from;
+        step = 1;
+        if (*end == '-') {
+            pos = end + 1;
+            to = strtoul(pos, &end, 10);
+            if (end == pos || to < from) {
+                printf("Error: cannot parse range in list '%s'\n", str);
+                exit(1);
+            }
+            if (*end == ':') {
+                pos = end + 1;
+                step = strtoul(pos, &end, 10);
+                if (end == pos || step == 0) {
+                    printf("Error: cannot parse step in list '%s'\n", str);
+                    exit(1);
+                }
+            }
+        }
+        for (; from <= to; from += step) {
+            ret = realloc(ret, (n + 1) * sizeof(unsigned long));
+            if (ret == NULL) {
+                err(1, "realloc");
+            }
+            ret[n++] = from;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            printf("Error: unexpected '%c' in list '%s'\n", *end, str);
+            exit(1);
+        }
+        pos = end;
+    }
+    if (n == 0) {
+        printf("Error: empty list\n");
+        exit(1);
+    }
+    *list = ret;
+    return n;
+}
+
+/* parse a size such as "64", "4k", "1.5M" or "2GiB". Plain numbers are MiB.
+ *
+ * return value: size in bytes
+ */
+unsigned long long parse_size(char const *str, char **end)
+{
+    double size = strtod(str, end);
+
+    if (*end == str || size < 0) {
+        printf("Error: cannot parse size '%s'\n", str);
+        exit(1);
+    }
+    switch (**end) {
+        case 'k':
+        case 'K':
+            size *= 1024;
+            (*end)++;
+            break;
+        case 'g':
+        case 'G':
+            size *= 1024*1024*1024;
+            (*end)++;
+            break;
+        case 'm':
+        case 'M':
+            (*end)++;
+            /* fall through */
+        default:
+            size *= 1024*1024;
+            break;
+    }
+    if (**end == 'i') {
+        (*end)++;
+    }
+    if (**end == 'B') {
+        (*end)++;
+    }
+    return size;
+}
+
+/* parse a comma-separated list of array sizes. from-to is a log2 grid
+ * (from, 2*from, 4*from, ... to), from-to:n uses n points per doubling.
+ * Sizes are rounded down to whole cache lines, so each must be at least 64 B.
+ *
+ * return value: number of list entries
+ */
+unsigned int parse_sizes(char const *str, unsigned long long **list)
+{
+    unsigned long long *ret = NULL;
+    unsigned int n = 0;
+    unsigned long long from, to, size;
+    unsigned long steps, i;
+    char const *pos = str;
+    char *end;
+
+    while (*pos) {
+        from = parse_size(pos, &end);
+        if (from < 64) {
+            printf("Error: size %llu B in list '%s' is less than one cache line (64 B)\n", from, str);
+            exit(1);
+        }
+        to = from;
+        steps = 1;
+        if (*end == '-') {
+            pos = end + 1;
+            to = parse_size(pos, &end);
+            if (to < from) {
+                printf("Error: cannot parse range in list '%s'\n", str);
+                exit(1);
+            }
+            if (*end == ':') {
+                pos = end + 1;
+                steps = strtoul(pos, &end, 10);
+                if (end == pos || steps == 0) {
+                    printf("Error: cannot parse steps in list '%s'\n", str);
+                    exit(1);
+                }
+            }
+        }
+        for (i = 0; ; i++) {
+            size = from * pow(2, (double)i / steps) + 0.5;
+            if (size > to) {
+                break;
+            }
+            size &= ~63ULL;
+            if (n == 0 || ret[n-1] != size) {
+                ret = realloc(ret, (n + 1) * sizeof(unsigned long long));
+                if (ret == NULL) {
+                    err(1, "realloc");
+                }
+                ret[n++] = size;
+            }
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            printf("Error: unexpected '%c' in list '%s'\n", *end, str);
+            exit(1);
+        }
+        pos = end;
+    }
+    if (n == 0) {
+        printf("Error: empty size list '%s'\n", str);
+        exit(1);
+    }
+    *list = ret;
+    return n;
+}
+
+/* read data and unified cache sizes of cpu0 from sysfs into cache_size[] */
+void detect_caches()
+{
+    char path[128], type[32];
+    unsigned int index, level;
+    unsigned long long size;
+    char unit;
+    FILE *f;
+
+    for (index = 0; ; index++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/level", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            return;
+        }
+        if (fscanf(f, "%u", &level) != 1) {
+            level = 0;
+        }
+        fclose(f);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/type", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            return;
+        }
+        if (fscanf(f, "%31s", type) != 1) {
+            type[0] = 0;
+        }
+        fclose(f);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/size", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            return;
+        }
+        unit = 0;
+        if (fscanf(f, "%llu%c", &size, &unit) < 1) {
+            size = 0;
+        }
+        fclose(f);
+
+        if (unit == 'K') {
+            size *= 1024;
+        } else if (unit == 'M') {
+            size *= 1024*1024;
+        }
+        if (level >= 1 && level <= MAX_CACHE_LEVEL && strcmp(type, "Instruction")) {
+            cache_size[level] = size;
+        }
+    }
+}
+
+/* bytes touched by one pass of the current test */
+unsigned long long working_set()
+{
+    unsigned long long array_bytes = arr_size * sizeof(long);
+
+    return __builtin_popcount(kernels[test_type].reads | kernels[test_type].writes) * array_bytes;
+}
+
+/* smallest cache level that holds the working set of the current test,
+ * 0 if it only fits into DRAM. L1 and L2 are assumed to be per-core,
+ * so only each thread's share of the working set needs to fit there.
+ */
+unsigned int cache_level(unsigned long threads)
+{
+    unsigned long long ws = working_set();
+    unsigned int level;
+
+    for (level = 1; level <= MAX_CACHE_LEVEL; level++) {
+        if (cache_size[level] && (level < MAX_CACHE_LEVEL ? ws / threads : ws) <= cache_size[level]) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+/* topology of a CPU as reported by sysfs */
+struct cpu_topo {
+    int cpu;
+    int package;
+    int core;
+    int smt; /* index among the hardware threads of this core */
+};
+
+int read_topology(int cpu, char const *name)
+{
+    char path[128];
+    FILE *f;
+    int ret = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    if ((f = fopen(path, "r")) != NULL) {
+        if (fscanf(f, "%d", &ret) != 1) {
+            ret = -1;
+        }
+        fclose(f);
+    }
+    return ret;
+}
+
+int cmp_compact(void const *a, void const *b)
+{
+    struct cpu_topo const *x = a, *y = b;
+
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    return x->cpu - y->cpu;
+}
+
+int cmp_scatter(void const *a, void const *b)
+{
+    struct cpu_topo const *x = a, *y = b;
+
+    if (x->smt != y->smt) {
+        return x->smt - y->smt;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    return x->cpu - y->cpu;
+}
+
+/* order the CPUs in cpus according to cpu_layout
+ *
+ * return value: number of CPUs written to order
+ */
+unsigned int layout_cpus(cpu_set_t *cpus, int *order)
+{
+    struct cpu_topo *topo;
+    unsigned int i, n = 0, ret = 0;
+    int cpu;
+
+    if (cpu_layout == LAYOUT_LIST) {
+        for (i = 0; i < nr_cpu_list; i++) {
+            order[i] = cpu_list[i];
+        }
+        return nr_cpu_list;
+    }
+
+    topo = calloc(CPU_COUNT(cpus), sizeof(struct cpu_topo));
+    if (topo == NULL) {
+        err(1, "calloc");
+    }
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, cpus)) {
+            topo[n].cpu = cpu;
+            topo[n].package = read_topology(cpu, "physical_package_id");
+            topo[n].core = read_topology(cpu, "core_id");
+            n++;
+        }
+    }
+    qsort(topo, n, sizeof(struct cpu_topo), cmp_compact);
+    for (i = 1; i < n; i++) {
+        if (topo[i].package == topo[i-1].package && topo[i].core == topo[i-1].core) {
+            topo[i].smt = topo[i-1].smt + 1;
+        }
+    }
+    if (cpu_layout == LAYOUT_SCATTER) {
+        qsort(topo, n, sizeof(struct cpu_topo), cmp_scatter);
+    }
+    for (i = 0; i < n; i++) {
+        if (cpu_layout != LAYOUT_CORES || topo[i].smt == 0) {
+            order[ret++] = topo[i].cpu;
+        }
+    }
+    free(topo);
+    return ret;
+}
+
+/* pin each thread (or, in the single-threaded build, the main thread) to a
+ * CPU of the selected layout. Only CPUs of the -c node are used, if any. */
+void pin_threads(unsigned long threads_used)
+{
+    cpu_set_t cpus = cpus_allowed;
+    int *order = calloc(CPU_SETSIZE, sizeof(int));
+    unsigned int i, n;
+
+    if (order == NULL) {
+        err(1, "calloc");
+    }
+#ifdef NUMA
+    if (numa_node_cpu != -1) {
+        struct bitmask *node_cpus = numa_allocate_cpumask();
+        if (numa_node_to_cpus(numa_node_cpu, node_cpus) == 0) {
+            for (i = 0; i < CPU_SETSIZE; i++) {
+                if (!numa_bitmask_isbitset(node_cpus, i)) {
+                    CPU_CLR(i, &cpus);
+                }
+            }
+        }
+        numa_free_cpumask(node_cpus);
+    }
+#endif
+    n = layout_cpus(&cpus, order);
+    if (n == 0) {
+        printf("Error: no CPUs available for the selected layout\n");
+        exit(1);
+    }
+    if (n < threads_used) {
+        fprintf(stderr, "Warning: %lu threads share %u CPUs\n", threads_used, n);
+    }
+    for (i = 0; i < threads_used; i++) {
+        thread_cpu[i] = order[i % n];
+        CPU_ZERO(&cpus);
+        CPU_SET(thread_cpu[i], &cpus);
+#ifdef MULTITHREADED
+        if (pthread_setaffinity_np(threads[i], sizeof(cpus), &cpus) != 0) {
+            err(1, "pthread_setaffinity_np(cpu %d)", thread_cpu[i]);
+        }
+#else
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            err(1, "sched_setaffinity(cpu %d)", thread_cpu[i]);
+        }
+#endif
+    }
+    free(order);
+}
+
+/* result records are either text lines of the form
+ *   [::] <test> | key=value ... | key=value ...
+ * or, with -J, one JSON object per line. In text mode only samples use the
+ * original "[::]" prefix, summaries and other records are marked with
+ * their kind, e.g. "[::summary]", so that scrapers of the original format
+ * do not count them as samples. Each record is flushed once it
+ * is complete so that long sweeps can be consumed while they run. */
+
+void json_string(char const *str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            printf("\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            printf("\\u%04x", *str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+void out_begin(char const *type, char const *test, char const *stat)
+{
+    if (output_json) {
+        printf("{\"type\": \"%s\", \"test\": ", type);
+        json_string(test);
+        printf(", \"stat\": \"%s\"", stat);
+    } else if (strcmp(type, "result")) {
+        printf("[::%s] %s |", type, test);
+    } else {
+        printf("[::%s] %s |", strcmp(stat, "sample") ? stat : "", test);
+    }
+}
+
+/* numeric field, fmt must print a valid JSON number */
+void out_field(char const *key, char const *fmt, ...)
+{
+    va_list ap;
+
+    printf(output_json ? ", \"%s\": " : " %s=", key);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+void out_double(char const *key, double val)
+{
+    if (output_json && !isfinite(val)) {
+        printf(", \"%s\": null", key);
+    } else {
+        out_field(key, "%.9g", val);
+    }
+}
+
+/* field of the original text format, which printed it with "%f" */
+void out_legacy_double(char const *key, double val)
+{
+    if (output_json) {
+        out_double(key, val);
+    } else {
+        out_field(key, "%f", val);
+    }
+}
+
+void out_str(char const *key, char const *val)
+{
+    if (output_json) {
+        printf(", \"%s\": ", key);
+        json_string(val);
+    } else {
+        printf(" %s=%s", key, val);
+    }
+}
+
+/* field that does not apply to this build or test */
+void out_na(char const *key)
+{
+    printf(output_json ? ", \"%s\": null" : " %s=X", key);
+}
+
+/* separates parameters from results in text mode */
+void out_sep()
+{
+    if (!output_json) {
+        printf(" |");
+    }
+}
+
+void out_end()
+{
+    printf(output_json ? "}\n" : "\n");
+    fflush(stdout);
+}
+
+/* host and build description, the first record in JSON mode */
+void print_meta()
+{
+    struct utsname uts;
+    char model[256] = "unknown", line[512], key[16];
+    char *colon;
+    FILE *f;
+
+    if ((f = fopen("/proc/cpuinfo", "r")) != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (!strncmp(line, "model name", 10) && (colon = strchr(line, ':')) != NULL) {
+                snprintf(model, sizeof(model), "%s", colon + 2);
+                model[strcspn(model, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(f);
+    }
+    if (uname(&uts) != 0) {
+        err(1, "uname");
+    }
+
+    printf("{\"type\": \"meta\"");
+    out_str("version", VERSION);
+    out_str("git_version", GIT_VERSION);
+    out_str("compiler", __VERSION__);
+    out_str("cflags", BUILD_CFLAGS);
+#ifdef MULTITHREADED
+    out_field("multithreaded", "true");
+#else
+    out_field("multithreaded", "false");
+#endif
+#ifdef NUMA
+    out_field("numa", "true");
+    out_field("numa_nodes", "%d", numa_num_configured_nodes());
+#else
+    out_field("numa", "false");
+    out_na("numa_nodes");
+#endif
+    out_str("isa", isa_name(isa_supported));
+    out_str("timer", timer_names[timer]);
+    out_double("timer_hz", 1 / timer_period);
+    out_double("timer_overhead_ns", timer_overhead * 1e9);
+    out_str("hostname", uts.nodename);
+    out_str("kernel", uts.release);
+    out_str("kernel_version", uts.version);
+    out_str("machine", uts.machine);
+    out_str("cpu_model", model);
+    out_field("nr_cpus", "%ld", sysconf(_SC_NPROCESSORS_ONLN));
+    out_field("page_size_B", "%ld", sysconf(_SC_PAGESIZE));
+    for (unsigned int i = 1; i <= MAX_CACHE_LEVEL; i++) {
+        snprintf(key, sizeof(key), "l%u_cache_B", i);
+        out_field(key, "%llu", cache_size[i]);
+    }
+    out_end();
+}
+
+void print_cpus(unsigned long threads_used)
+{
+    if (cpu_layout == LAYOUT_NONE) {
+        out_na("cpus");
+        return;
+    }
+    printf(output_json ? ", \"cpus\": [" : " cpus=");
+    for (unsigned long i = 0; i < threads_used; i++) {
+        printf(i ? ",%d" : "%d", thread_cpu[i]);
+    }
+    if (output_json) {
+        printf("]");
+    }
+}
+
+/* granularity of array allocations and NUMA bindings for the selected
+ * backend: the huge page size for hugetlbfs, the base page size otherwise */
+unsigned long alloc_page_size()
+{
+    if (alloc_backend == ALLOC_HUGETLB_2M) {
+        return 2UL*1024*1024;
+    }
+    if (alloc_backend == ALLOC_HUGETLB_1G) {
+        return 1024UL*1024*1024;
+    }
+    return sysconf(_SC_PAGESIZE);
+}
+
+/* bytes to allocate for an array of nr_elem elements */
+unsigned long long alloc_bytes(unsigned long long nr_elem)
+{
+    unsigned long page_size = alloc_page_size();
+
+    return (nr_elem * sizeof(long) + page_size - 1) & ~(unsigned long long)(page_size - 1);
+}
+
+#ifdef NUMA
+/* parse a -a/-b argument: a single nodestring, or one node per sweep point
+ * in sweep mode. NULL (no argument) yields a single point without binding.
+ *
+ * return value: number of sweep points
+ */
+unsigned int parse_nodes(char const *str, struct bitmask ***masks)
+{
+    struct bitmask **ret;
+    unsigned long *nodes;
+    unsigned int i, n = 1;
+
+    if (str != NULL && sweep) {
+        n = parse_list(str, &nodes);
+    }
+    ret = calloc(n, sizeof(struct bitmask*));
+    if (ret == NULL) {
+        err(1, "calloc");
+    }
+    if (str != NULL && sweep) {
+        for (i = 0; i < n; i++) {
+            if (nodes[i] > (unsigned long)numa_max_node()) {
+                printf("Error: NUMA node %lu does not exist\n", nodes[i]);
+                exit(1);
+            }
+            ret[i] = numa_allocate_nodemask();
+            numa_bitmask_setbit(ret[i], nodes[i]);
+        }
+        free(nodes);
+    } else if (str != NULL) {
+        ret[0] = numa_parse_nodestring(str);
+        if (ret[0] == NULL) {
+            printf("Error: cannot parse NUMA nodes '%s'\n", str);
+            exit(1);
+        }
+    }
+    *masks = ret;
+    return n;
+}
+
+/* NUMA node holding most pages of the first nr_elem elements of arr (-1
+ * if unknown). Every page is queried, pct is set to the share of pages on
+ * the returned node. */
+int array_node(long *arr, unsigned long long nr_elem, char const *name, double *pct)
+{
+    unsigned long page_size = alloc_page_size();
+    unsigned long long pages, i, n;
+    unsigned long *count;
+    int node = -1;
+
+    *pct = 0;
+    if (arr == NULL || nr_elem == 0) {
+        return -1;
+    }
+    count = calloc(numa_max_node() + 1, sizeof(unsigned long));
+    if (count == NULL) {
+        err(1, "calloc");
+    }
+    pages = ((uintptr_t)(arr + nr_elem) - ((uintptr_t)arr & ~(page_size - 1)) + page_size - 1) / page_size;
+    for (i = 0; i < pages; i += n) {
+        n = pages - i < MP_BATCH ? pages - i : MP_BATCH;
+        for (unsigned long long j = 0; j < n; j++) {
+            mp_pages[j] = (void*)(((uintptr_t)arr & ~(page_size - 1)) + (i + j) * page_size);
+        }
+        if (move_pages(0, n, mp_pages, NULL, mp_status, 0) == -1) {
+            perror(name);
+            free(count);
+            return -1;
+        }
+        for (unsigned long long j = 0; j < n; j++) {
+            /* negative: page not present */
+            if (mp_status[j] >= 0 && mp_status[j] <= numa_max_node()) {
+                count[mp_status[j]]++;
+            }
+        }
+    }
+    for (i = 0; i <= (unsigned long long)numa_max_node(); i++) {
+        if (count[i] > 0 && (node == -1 || count[i] > count[node])) {
+            node = i;
+        }
+    }
+    if (node == -1) {
+        printf("%s error: no page is present\n", name);
+    } else {
+        *pct = 100.0 * count[node] / pages;
+    }
+    free(count);
+    return node;
+}
+
+/* bind nr_elem elements of an array to (MPOL_BIND) or interleave them over
+ * (MPOL_INTERLEAVE) the nodes in mask. With
+ * MPOL_MF_MOVE, already populated pages are migrated, so that sweep points
+ * can reuse the array. */
+void bind_array(long *arr, unsigned long long nr_elem, struct bitmask *mask, int mode, unsigned int flags)
+{
+    unsigned long page_size = alloc_page_size();
+    unsigned long start = (unsigned long)arr & ~(page_size - 1);
+    unsigned long end = ((unsigned long)(arr + nr_elem) + page_size - 1) & ~(page_size - 1);
+
+    if (arr == NULL || mask == NULL || nr_elem == 0) {
+        return;
+    }
+    if (mbind((void*)start, end - start, mode, mask->maskp, mask->size + 1, flags) != 0) {
+        perror("mbind");
+    }
+}
+
+/* schedule the main thread and all pool threads on a NUMA node */
+void run_on_node(int node)
+{
+    if (numa_run_on_node(node) == -1) {
+        perror("numa_run_on_node");
+        numa_node_cpu = -1;
+    }
+#ifdef MULTITHREADED
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        err(1, "pthread_getaffinity_np");
+    }
+    main_cpus = CPU_COUNT(&cpus);
+    for (unsigned int i = 0; i < max_threads; i++) {
+        if (pthread_setaffinity_np(threads[i], sizeof(cpus), &cpus) != 0) {
+            err(1, "pthread_setaffinity_np");
+        }
+    }
+#endif
+}
+#endif
+
+/* allocate a test array with the selected backend (-H). It is populated by
+ * init_array, so that each page is first touched by the thread that later
+ * streams it. */
+long *make_array()
+{
+    unsigned long page_size = alloc_page_size();
+    unsigned long long bytes = alloc_bytes(arr_size);
+    unsigned long long slack;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    uint8_t *a;
+
+    if (alloc_backend == ALLOC_MALLOC) {
+        a=aligned_alloc(page_size, bytes);
+        if(NULL==a) {
+            perror("Error allocating memory");
+            exit(1);
+        }
+        return (long*)a;
+    }
+
+    if (alloc_backend == ALLOC_HUGETLB_2M) {
+        flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+    } else if (alloc_backend == ALLOC_HUGETLB_1G) {
+        flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+    }
+    /* over-allocate THP mappings so that they can start at a huge page boundary */
+    slack = alloc_backend == ALLOC_THP ? THP_SIZE : 0;
+    a = mmap(NULL, bytes + slack, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (a == MAP_FAILED) {
+        if (flags & MAP_HUGETLB) {
+            err(1, "mmap(%s): are enough huge pages reserved in /sys/kernel/mm/hugepages?", alloc_names[alloc_backend]);
+        }
+        err(1, "mmap");
+    }
+    if (slack) {
+        uint8_t *aligned = (uint8_t*)(((uintptr_t)a + slack - 1) & ~(uintptr_t)(slack - 1));
+        if (aligned > a) {
+            munmap(a, aligned - a);
+        }
+        munmap(aligned + bytes, a + slack - aligned);
+        a = aligned;
+    }
+    if (alloc_backend == ALLOC_THP && madvise(a, bytes, MADV_HUGEPAGE) != 0) {
+        perror("madvise(MADV_HUGEPAGE)");
+    } else if (alloc_backend == ALLOC_NOTHP && madvise(a, bytes, MADV_NOHUGEPAGE) != 0) {
+        perror("madvise(MADV_NOHUGEPAGE)");
+    }
+    return (long*)a;
+}
+
+/* map path as a test array. Regular files are extended to the array size,
+ * device files (DAX) are mapped as they are. With MAP_SHARED, the file
+ * contents are overwritten by init_array and the write tests. */
+long *map_file(char const *path, struct file_map *map)
+{
+    unsigned long long bytes = alloc_bytes(arr_size);
+    struct statfs sfs;
+    struct stat st;
+    void *a;
+    int fd;
+
+    if ((fd = open(path, O_RDWR | O_CREAT, 0644)) == -1) {
+        err(1, "open(%s)", path);
+    }
+    if (fstat(fd, &st) != 0) {
+        err(1, "fstat(%s)", path);
+    }
+    /* hugetlbfs mappings are multiples of its page size */
+    if (fstatfs(fd, &sfs) == 0 && sfs.f_type == HUGETLBFS_MAGIC) {
+        bytes = (bytes + sfs.f_bsize - 1) / sfs.f_bsize * sfs.f_bsize;
+    }
+    if (S_ISREG(st.st_mode) && (unsigned long long)st.st_size < bytes && ftruncate(fd, bytes) != 0) {
+        err(1, "ftruncate(%s)", path);
+    }
+    a = mmap(NULL, bytes, PROT_READ | PROT_WRITE, file_map_flags, fd, 0);
+    if (a == MAP_FAILED) {
+        err(1, "mmap(%s)", path);
+    }
+    close(fd);
+    map->addr = a;
+    map->len = bytes;
+    return (long*)a;
+}
+
+void free_array(long *a, unsigned long long nr_elem)
+{
+    if (a == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < 2; i++) {
+        if (file_maps[i].addr == a) {
+            munmap(a, file_maps[i].len);
+            return;
+        }
+    }
+    if (alloc_backend == ALLOC_MALLOC) {
+        free(a);
+    } else {
+        munmap(a, alloc_bytes(nr_elem));
+    }
+}
+
+/* KernelPageSize and the share of transparent huge pages (anonymous, shmem
+ * or file backed) in the resident set of the mapping containing addr, read
+ * from /proc/self/smaps */
+void page_info(void *addr, unsigned long *page_size, double *thp_pct)
+{
+    char line[256];
+    unsigned long start, end, val, rss = 0, thp = 0;
+    int found = 0;
+    FILE *f;
+
+    *page_size = 0;
+    *thp_pct = 0;
+    if (addr == NULL || (f = fopen("/proc/self/smaps", "r")) == NULL) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (found) {
+                break;
+            }
+            found = (uintptr_t)addr >= start && (uintptr_t)addr < end;
+        } else if (found) {
+            if (sscanf(line, "KernelPageSize: %lu kB", &val) == 1) {
+                *page_size = val * 1024;
+            } else if (sscanf(line, "Rss: %lu kB", &val) == 1) {
+                rss = val;
+            } else if (sscanf(line, "AnonHugePages: %lu kB", &val) == 1 ||
+                    sscanf(line, "ShmemPmdMapped: %lu kB", &val) == 1 ||
+                    sscanf(line, "FilePmdMapped: %lu kB", &val) == 1) {
+                /* only one of them is non-zero for a mapping */
+                thp += val;
+            }
+        }
+    }
+    fclose(f);
+    if (rss) {
+        *thp_pct = 100.0 * thp / rss;
+    }
+}
+
+/* timestamp taken before a timed region. With the TSC backend the
+ * lfences keep the region's instructions from executing before or
+ * overlapping with rdtsc. */
+static inline timestamp timer_start()
+{
+    struct timespec ts;
+
+#ifdef HAVE_X86
+    if (timer == TIMER_TSC) {
+        timestamp t;
+        _mm_lfence();
+        t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* timestamp taken after a timed region. mfence drains the stores of
+ * the region, rdtscp waits for all its instructions to complete. */
+static inline timestamp timer_stop()
+{
+    struct timespec ts;
+
+#ifdef HAVE_X86
+    if (timer == TIMER_TSC) {
+        unsigned int aux;
+        timestamp t;
+        _mm_mfence();
+        t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* seconds between two timestamps, negative if end is before start */
+static inline double elapsed(timestamp start, timestamp end)
+{
+    return (double)(long long)(end - start) * timer_period;
+}
+
+/* duration of a timed run, without the cost of the timestamps */
+static inline double run_time(timestamp start, timestamp end)
+{
+    return elapsed(start, end) - timer_overhead;
+}
+
+/* check the selected timer, calibrate the TSC against CLOCK_MONOTONIC
+ * and measure the timer overhead */
+void timer_init()
+{
+    timestamp t0, t1;
+    double te;
+
+#ifdef HAVE_X86
+    if (timer == TIMER_TSC) {
+        unsigned int eax, ebx, ecx, edx;
+        struct timespec c0, c1;
+
+        /* CPUID.80000001H:EDX[27] is rdtscp, CPUID.80000007H:EDX[8] the invariant TSC */
+        if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 27))) {
+            printf("Error: the CPU does not support rdtscp\n");
+            exit(1);
+        }
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))) {
+            warnx("the TSC is not invariant, its rate may change with the CPU clock");
+        }
+        /* ticks over 100 ms of CLOCK_MONOTONIC */
+        clock_gettime(CLOCK_MONOTONIC, &c0);
+        t0 = timer_start();
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &c1);
+            te = (double)(c1.tv_sec - c0.tv_sec) + (double)(c1.tv_nsec - c0.tv_nsec) / 1000000000;
+        } while (te < 0.1);
+        t1 = timer_stop();
+        timer_period = te / (t1 - t0);
+    }
+#else
+    if (timer == TIMER_TSC) {
+        printf("Error: the tsc timer is only available on x86\n");
+        exit(1);
+    }
+#endif
+    /* cheapest of back to back timestamp pairs */
+    timer_overhead = -1;
+    for (unsigned int i = 0; i < 1000; i++) {
+        t0 = timer_start();
+        t1 = timer_stop();
+        te = elapsed(t0, t1);
+        if (timer_overhead < 0 || te < timer_overhead) {
+            timer_overhead = te;
+        }
+    }
+}
+
+long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+/* open the counters of the calling thread */
+void perf_open(struct counters *c)
+{
+    struct perf_event_attr attr;
+    int fd;
+
+    c->opened = 1;
+    c->leader = -1;
+    c->nr = 0;
+    for (unsigned int i = 0; i < NR_COUNTERS; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_defs[i].type;
+        attr.config = counter_defs[i].config;
+        attr.disabled = c->leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd = perf_event_open(&attr, 0, -1, c->leader, 0);
+        if (fd < 0) {
+            if (!__atomic_exchange_n(&counter_warned[i], 1, __ATOMIC_RELAXED)) {
+                warn("perf_event_open(%s)", counter_defs[i].name);
+            }
+            c->pos[i] = -1;
+            continue;
+        }
+        if (c->leader == -1) {
+            c->leader = fd;
+        }
+        c->pos[i] = c->nr++;
+    }
+}
+
+static inline void perf_start(struct counters *c)
+{
+    if (!c->opened) {
+        perf_open(c);
+    }
+    if (c->leader != -1) {
+        ioctl(c->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(c->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static inline void perf_stop(struct counters *c)
+{
+    /* nr, time_enabled, time_running, values */
+    unsigned long long buf[3 + NR_COUNTERS];
+
+    if (c->leader == -1) {
+        return;
+    }
+    ioctl(c->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(c->leader, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(buf[0]))) {
+        memset(buf, 0, sizeof(buf));
+    }
+    /* counts of a group that shared the PMU with other events are
+     * extrapolations, they are reported as not available */
+    c->multiplexed = buf[2] < buf[1];
+    for (unsigned int i = 0; i < NR_COUNTERS; i++) {
+        c->val[i] = c->pos[i] >= 0 ? buf[3 + c->pos[i]] : 0;
+    }
+}
+
+/* read a sysfs file of an event source into buf */
+int read_pmu_file(char const *pmu, char const *file, char *buf, size_t len)
+{
+    char path[512];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/sys/bus/event_source/devices/%s/%s", pmu, file);
+    if ((f = fopen(path, "r")) == NULL) {
+        return -1;
+    }
+    if (fgets(buf, len, f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* open the CAS counters of all Intel uncore memory controllers. This
+ * needs perf_event_paranoid <= 0 or CAP_PERFMON, without them the
+ * imc fields are not available. */
+void imc_open()
+{
+    char const *events[2] = {"events/cas_count_read", "events/cas_count_write"};
+    char buf[256];
+    struct perf_event_attr attr;
+    struct dirent *de;
+    unsigned long long config[2];
+    unsigned long *cpus;
+    unsigned int nr_cpus;
+    DIR *dir;
+    int fd[2];
+    char *str;
+
+    if ((dir = opendir("/sys/bus/event_source/devices")) == NULL) {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "uncore_imc", 10)) {
+            continue;
+        }
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        if (read_pmu_file(de->d_name, "type", buf, sizeof(buf)) != 0) {
+            continue;
+        }
+        attr.type = strtoul(buf, NULL, 10);
+        attr.disabled = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        config[0] = config[1] = 0;
+        for (unsigned int i = 0; i < 2; i++) {
+            if (read_pmu_file(de->d_name, events[i], buf, sizeof(buf)) != 0) {
+                break;
+            }
+            /* "event=0x04,umask=0x03" */
+            if ((str = strstr(buf, "event=")) != NULL) {
+                config[i] |= strtoull(str + 6, NULL, 0);
+            }
+            if ((str = strstr(buf, "umask=")) != NULL) {
+                config[i] |= strtoull(str + 6, NULL, 0) << 8;
+            }
+        }
+        /* PMUs without CAS counts, e.g. uncore_imc_free_running_0, are
+         * not memory controller channels */
+        if (!config[0] || !config[1]) {
+            continue;
+        }
+        /* one CPU per socket, e.g. "0,18" */
+        if (read_pmu_file(de->d_name, "cpumask", buf, sizeof(buf)) != 0) {
+            strcpy(buf, "0");
+        }
+        buf[strcspn(buf, "\n")] = '\0';
+        nr_cpus = parse_list(buf, &cpus);
+        for (unsigned int c = 0; c < nr_cpus; c++) {
+            for (unsigned int i = 0; i < 2; i++) {
+                attr.config = config[i];
+                fd[i] = perf_event_open(&attr, -1, cpus[c], -1, 0);
+            }
+            if (fd[0] < 0 || fd[1] < 0 || nr_imc == MAX_IMC) {
+                /* counting only some of the controllers would report
+                 * too little traffic, so count none */
+                warn("perf_event_open(%s, cpu %lu)", de->d_name, cpus[c]);
+                for (unsigned int i = 0; i < 2; i++) {
+                    if (fd[i] >= 0) {
+                        close(fd[i]);
+                    }
+                }
+                for (unsigned int i = 0; i < nr_imc; i++) {
+                    close(imc_fd[0][i]);
+                    close(imc_fd[1][i]);
+                }
+                nr_imc = 0;
+                free(cpus);
+                closedir(dir);
+                return;
+            }
+            imc_fd[0][nr_imc] = fd[0];
+            imc_fd[1][nr_imc] = fd[1];
+            nr_imc++;
+        }
+        free(cpus);
+    }
+    closedir(dir);
+}
+
+void imc_start()
+{
+    for (unsigned int i = 0; i < nr_imc; i++) {
+        for (unsigned int j = 0; j < 2; j++) {
+            ioctl(imc_fd[j][i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(imc_fd[j][i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void imc_stop()
+{
+    /* value, time_enabled, time_running */
+    unsigned long long val[3];
+
+    imc_val[0] = imc_val[1] = 0;
+    imc_multiplexed = 0;
+    for (unsigned int i = 0; i < nr_imc; i++) {
+        for (unsigned int j = 0; j < 2; j++) {
+            ioctl(imc_fd[j][i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(imc_fd[j][i], val, sizeof(val)) != sizeof(val) || val[2] < val[1]) {
+                imc_multiplexed = 1;
+                continue;
+            }
+            imc_val[j] += val[0];
+        }
+    }
+}
+
+/* print counter totals and derived metrics of the last run.
+ * te: elapsed time, mt: requested data in MiB */
+void print_counters(double te, double mt)
+{
+    unsigned long long total[NR_COUNTERS] = {0};
+    int avail[NR_COUNTERS] = {0};
+    double thread_time = te;
+    unsigned long threads = 1;
+
+#ifdef MULTITHREADED
+    threads = num_threads;
+    thread_time = 0;
+    for (unsigned long t = 0; t < threads; t++) {
+        thread_time += run_time(thread_times[t].start, thread_times[t].end);
+    }
+#endif
+    for (unsigned long t = 0; t < threads; t++) {
+        for (unsigned int i = 0; i < NR_COUNTERS; i++) {
+            if (thread_counters[t].pos[i] >= 0) {
+                total[i] += thread_counters[t].val[i];
+                avail[i] = 1;
+            }
+        }
+    }
+    for (unsigned long t = 0; t < threads; t++) {
+        if (thread_counters[t].multiplexed) {
+            memset(avail, 0, sizeof(avail));
+        }
+    }
+    for (unsigned int i = 0; i < NR_COUNTERS; i++) {
+        if (avail[i]) {
+            out_field(counter_defs[i].name, "%llu", total[i]);
+        } else {
+            out_na(counter_defs[i].name);
+        }
+    }
+    if (avail[CNT_CYCLES] && avail[CNT_INSTRUCTIONS]) {
+        out_double("ipc", (double)total[CNT_INSTRUCTIONS] / total[CNT_CYCLES]);
+    } else {
+        out_na("ipc");
+    }
+    /* average clock of the threads while they ran the kernel */
+    if (avail[CNT_CYCLES]) {
+        out_double("ghz", total[CNT_CYCLES] / thread_time / 1e9);
+    } else {
+        out_na("ghz");
+    }
+    if (nr_imc && !imc_multiplexed) {
+        out_field("imc_read_B", "%llu", imc_val[0] * 64);
+        out_field("imc_write_B", "%llu", imc_val[1] * 64);
+        out_double("dram_per_requested", (imc_val[0] + imc_val[1]) * 64 / (mt * 1024 * 1024));
+    } else {
+        out_na("imc_read_B");
+        out_na("imc_write_B");
+        out_na("dram_per_requested");
+    }
+}
+
+/* elements of the array a run of k processes per repetition. Kernels
+ * that work in cache lines leave out a partial last line. */
+static inline unsigned long long touched_elems(struct kernel const *k)
+{
+    return k->flags & KF_ALIGN64 ? arr_size & ~7ULL : arr_size;
+}
+
+#ifdef MULTITHREADED
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* wait until the main thread starts a new run (start_gen != seen) and
+ * this thread is part of it, or the pool is shut down
+ *
+ * return value: the new start_gen
+ */
+unsigned int wait_start(unsigned long thread_id, unsigned int seen)
+{
+    unsigned int gen;
+
+    if (thread_id >= num_threads && !done) {
+        pthread_mutex_lock(&pool_mutex);
+        while (thread_id >= num_threads && !done) {
+            pthread_cond_wait(&idle_cond, &pool_mutex);
+        }
+        /* runs started while this thread was idle do not concern it */
+        seen = idle_gen;
+        pthread_mutex_unlock(&pool_mutex);
+    }
+    for (unsigned long i = 0; i < SPIN_LIMIT; i++) {
+        if ((gen = __atomic_load_n(&start_gen, __ATOMIC_ACQUIRE)) != seen) {
+            return gen;
+        }
+        cpu_relax();
+    }
+    pthread_mutex_lock(&pool_mutex);
+    __atomic_add_fetch(&start_sleepers, 1, __ATOMIC_SEQ_CST);
+    while ((gen = __atomic_load_n(&start_gen, __ATOMIC_SEQ_CST)) == seen) {
+        pthread_cond_wait(&start_cond, &pool_mutex);
+    }
+    __atomic_sub_fetch(&start_sleepers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool_mutex);
+    return gen;
+}
+
+/* report completion of a run to the main thread */
+void signal_stop()
+{
+    if (__atomic_add_fetch(&stop_count, 1, __ATOMIC_SEQ_CST) == num_threads
+            && __atomic_load_n(&stop_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pool_mutex);
+        pthread_cond_signal(&stop_cond);
+        pthread_mutex_unlock(&pool_mutex);
+    }
+}
+
+/* elements of the test arrays processed by a thread with the static
+ * split. The slices cover the whole array (up to the last full cache line
+ * for KF_ALIGN64), their sizes differ by at most one element or line.
+ * Array size and thread count may change between sweep points. */
+void thread_range(unsigned long thread_id, struct kernel const *k, unsigned long long *start, unsigned long long *stop)
+{
+    unsigned long long const end = touched_elems(k);
+
+    *start = end * thread_id / num_threads;
+    *stop = end * (thread_id + 1) / num_threads;
+    if (k->flags & KF_ALIGN64) {
+        *start &= ~7ULL;
+        *stop &= ~7ULL;
+    }
+}
+
+/* whether threads run k with dynamic scheduling. The pointer chains of
+ * the latency tests are built per static slice. */
+static inline int dynamic_schedule(struct kernel const *k)
+{
+    return chunk_elems && !k->chase_stride;
+}
+
+/* claim chunks from chunk_cursor until all repetitions of the array are
+ * done
+ *
+ * return value: sum of k's return values over the claimed chunks
+ */
+long run_chunks(unsigned long thread_id, struct kernel const *k)
+{
+    unsigned long long const end = touched_elems(k);
+    unsigned long long const nr_chunks = (end + chunk_elems - 1) / chunk_elems;
+    unsigned long long const total = nr_chunks * repetitions;
+    unsigned long long c, start, stop, elems = 0;
+    long sum = 0;
+
+    while ((c = __atomic_fetch_add(&chunk_cursor.next, 1, __ATOMIC_RELAXED)) < total) {
+        start = c % nr_chunks * chunk_elems;
+        stop = start + chunk_elems < end ? start + chunk_elems : end;
+        sum += k->fn(start, stop);
+        elems += stop - start;
+    }
+    thread_times[thread_id].elems = elems;
+    return sum;
+}
+
+/* generate background traffic until thread 0 has finished its latency
+ * measurement. Each thread does at least one chunk, so that a thread that
+ * starts late still measures a bandwidth. */
+void run_load(unsigned long thread_id, struct kernel const *k)
+{
+    unsigned long long start, stop, pos, end;
+    unsigned long long elems = 0;
+
+    thread_range(thread_id, k, &start, &stop);
+    pos = start;
+    while (start < stop) {
+        end = pos + LOAD_CHUNK < stop ? pos + LOAD_CHUNK : stop;
+        k->fn(pos, end);
+        elems += end - pos;
+        pos = end == stop ? start : end;
+        for (unsigned long d = 0; d < inject_delay; d++) {
+            cpu_relax();
+        }
+        if (__atomic_load_n(&probe_done, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    thread_times[thread_id].load_bytes = elems * sizeof(long) * k->data_factor;
+}
+
+void *thread_worker(void *arg)
+{
+    unsigned long thread_id = (unsigned long)arg;
+    unsigned long r;
+
+    unsigned int gen = 0;
+
+    while (1) {
+        gen = wait_start(thread_id, gen);
+        if (done) {
+            return NULL;
+        }
+        if (thread_id >= num_threads) {
+            continue;
+        }
+        if (pool_job != NULL) {
+            pool_job(thread_id);
+            signal_stop();
+            continue;
+        }
+        struct kernel const *k = &kernels[test_type];
+        unsigned long long start, stop;
+        long sum = 0;
+        thread_range(thread_id, k, &start, &stop);
+        if (perf_enabled) {
+            perf_start(&thread_counters[thread_id]);
+        }
+        thread_times[thread_id].start = timer_start();
+        if (load_test >= 0 && k->chase_stride && thread_id > 0) {
+            run_load(thread_id, &kernels[load_test]);
+            thread_times[thread_id].elems = (stop - start) * repetitions;
+        } else if (dynamic_schedule(k)) {
+            sum = run_chunks(thread_id, k);
+        } else {
+            for (r=0; r<repetitions; r++) {
+                sum = k->fn(start, stop);
+            }
+            thread_times[thread_id].elems = (stop - start) * repetitions;
+            __atomic_store_n(&probe_done, 1, __ATOMIC_RELAXED);
+        }
+        if (sanity_check) {
+            partial_sum[thread_id] = sum;
+        }
+        thread_times[thread_id].end = timer_stop();
+        if (perf_enabled) {
+            perf_stop(&thread_counters[thread_id]);
+        }
+        signal_stop();
+    }
+    return NULL;
+}
+
+void start_threads()
+{
+    __atomic_store_n(&stop_count, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&start_gen, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&start_sleepers, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pool_mutex);
+        pthread_cond_broadcast(&start_cond);
+        pthread_mutex_unlock(&pool_mutex);
+    }
+}
+
+void await_threads()
+{
+    for (unsigned long i = 0; num_threads < main_cpus && i < SPIN_LIMIT; i++) {
+        if (__atomic_load_n(&stop_count, __ATOMIC_ACQUIRE) == num_threads) {
+            return;
+        }
+        cpu_relax();
+    }
+    pthread_mutex_lock(&pool_mutex);
+    __atomic_store_n(&stop_sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&stop_count, __ATOMIC_SEQ_CST) != num_threads) {
+        pthread_cond_wait(&stop_cond, &pool_mutex);
+    }
+    __atomic_store_n(&stop_sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+/* change the number of active pool threads between runs */
+void set_num_threads(unsigned long n)
+{
+    pthread_mutex_lock(&pool_mutex);
+    num_threads = n;
+    idle_gen = start_gen;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+/* MiB of the run's mt MiB moved by a thread, by its share of the
+ * processed elements */
+double thread_data(unsigned long thread_id, double mt)
+{
+    unsigned long long total = 0;
+
+    for (unsigned long i = 0; i < num_threads; i++) {
+        total += thread_times[i].elems;
+    }
+    return total ? mt * thread_times[thread_id].elems / total : 0;
+}
+
+/* print per-thread bandwidth and start/stop skew of the last run */
+void print_thread_times(double mt)
+{
+    timestamp first_start = thread_times[0].start, last_start = thread_times[0].start;
+    timestamp first_end = thread_times[0].end, last_end = thread_times[0].end;
+    double te, bw_min = 0, bw_max = 0;
+
+    for (unsigned long i = 0; i < num_threads; i++) {
+        te = run_time(thread_times[i].start, thread_times[i].end);
+        if (i == 0 || thread_data(i, mt) / te < bw_min) {
+            bw_min = thread_data(i, mt) / te;
+        }
+        if (i == 0 || thread_data(i, mt) / te > bw_max) {
+            bw_max = thread_data(i, mt) / te;
+        }
+        if (elapsed(first_start, thread_times[i].start) < 0) {
+            first_start = thread_times[i].start;
+        }
+        if (elapsed(last_start, thread_times[i].start) > 0) {
+            last_start = thread_times[i].start;
+        }
+        if (elapsed(first_end, thread_times[i].end) < 0) {
+            first_end = thread_times[i].end;
+        }
+        if (elapsed(last_end, thread_times[i].end) > 0) {
+            last_end = thread_times[i].end;
+        }
+    }
+    te = elapsed(first_start, last_end);
+    out_double("thread_min_MiBps", bw_min);
+    out_double("thread_max_MiBps", bw_max);
+    out_double("start_skew_s", elapsed(first_start, last_start));
+    out_double("end_skew_s", elapsed(first_end, last_end));
+    out_double("span_time_s", te);
+    out_double("span_throughput_MiBps", mt / te);
+}
+
+#ifdef NUMA
+/* print the bandwidth of each CPU node's threads to the memory node they
+ * used in the last run of the node matrix (-D matrix). All nodes ran at
+ * the same time. */
+void print_matrix(char const *test, double mt)
+{
+    for (int c = 0; c <= numa_max_node(); c++) {
+        unsigned long n = 0;
+        double bw = 0;
+        int m = -1;
+        for (unsigned long i = 0; i < num_threads; i++) {
+            if (thread_cpu_node[i] == c) {
+                bw += thread_data(i, mt) / run_time(thread_times[i].start, thread_times[i].end);
+                m = thread_mem_node[i];
+                n++;
+            }
+        }
+        if (n == 0) {
+            continue;
+        }
+        out_begin("matrix", test, "sample");
+        out_field("matrix_round", "%lu", place_shift);
+        out_field("cpu_numa_node", "%d", c);
+        out_field("mem_numa_node", "%d", m);
+        out_field("numa_distance", "%d", numa_distance(c, m));
+        out_field("n_threads", "%lu", n);
+        out_sep();
+        out_double("throughput_MiBps", bw);
+        out_end();
+    }
+}
+#endif
+
+/* run job on all active pool threads and wait for its completion */
+void run_pool_job(void (*job)(unsigned long thread_id))
+{
+    pool_job = job;
+    start_threads();
+    await_threads();
+    pool_job = NULL;
+}
+#endif
+
+/* ------------------------------------------------------ */
+
+/* array to be populated by init_array / init_job */
+long *init_arr;
+unsigned long long init_elems;
+
+#ifdef MULTITHREADED
+#ifdef NUMA
+/* position of a CPU node in place_nodes. Node IDs can be sparse and some
+ * nodes have memory but no CPUs, so the ID itself would map several CPU
+ * nodes to the same memory node. CPU nodes without memory fall back to
+ * their ID. */
+unsigned int place_pos(int node)
+{
+    for (unsigned int i = 0; i < nr_place_nodes; i++) {
+        if (place_nodes[i] == (unsigned long)node) {
+            return i;
+        }
+    }
+    return node % nr_place_nodes;
+}
+#endif
+
+/* populate this thread's page-aligned share of init_arr, so that its pages
+ * are first-touched by this thread and, with per-thread placement (-D, -L),
+ * bound to the node selected for it */
+void init_job(unsigned long thread_id)
+{
+    unsigned long page_elems = alloc_page_size() / sizeof(long);
+    unsigned long long pages = (init_elems + page_elems - 1) / page_elems;
+    unsigned long long start = thread_id * pages / num_threads * page_elems;
+    unsigned long long stop = (thread_id + 1) * pages / num_threads * page_elems;
+    unsigned long long t;
+    long sum = 0;
+
+    if (stop > init_elems) {
+        stop = init_elems;
+    }
+#ifdef NUMA
+    if (thread_placement >= PLACE_LOCAL && start < stop) {
+        struct bitmask *mask = numa_allocate_nodemask();
+        int cpu_node = numa_node_of_cpu(sched_getcpu());
+        int node = cpu_node;
+        if (thread_placement == PLACE_NODES) {
+            node = place_nodes[thread_id % nr_place_nodes];
+        } else if (thread_placement == PLACE_MATRIX) {
+            node = place_nodes[(place_pos(cpu_node) + place_shift) % nr_place_nodes];
+            thread_cpu_node[thread_id] = cpu_node;
+            thread_mem_node[thread_id] = node;
+        }
+        numa_bitmask_setbit(mask, node);
+        bind_array(init_arr + start, stop - start, mask, MPOL_BIND, MPOL_MF_MOVE);
+        numa_free_nodemask(mask);
+    }
+#endif
+    for (t = start; t < stop; t++) {
+        init_arr[t] = 0xaa;
+        sum += init_arr[t];
+    }
+    partial_sum[thread_id] = sum;
+}
+#endif
+
+/* fill the first nr_elem elements of arr with a pattern. This forces Linux
+ * to _really_ allocate them; the checksum is computed in the same pass.
+ *
+ * return value: sum of the elements
+ */
+long init_array(long *arr, unsigned long long nr_elem)
+{
+    long sum = 0;
+
+    if (arr == NULL) {
+        return 0;
+    }
+    init_arr = arr;
+    init_elems = nr_elem;
+#ifdef MULTITHREADED
+    run_pool_job(init_job);
+    for (unsigned long i = 0; i < num_threads; i++) {
+        sum += partial_sum[i];
+    }
+#else
+    for (unsigned long long t = 0; t < init_elems; t++) {
+        init_arr[t] = 0xaa;
+        sum += init_arr[t];
+    }
+#endif
+    return sum;
+}
+
+#ifdef MULTITHREADED
+void setup_job(unsigned long thread_id)
+{
+    unsigned long long start, stop;
+
+    thread_range(thread_id, &kernels[test_type], &start, &stop);
+    kernels[test_type].setup(start, stop);
+}
+#endif
+
+/* run the current test's setup function on each thread's share */
+void setup_kernel()
+{
+#ifdef MULTITHREADED
+    run_pool_job(setup_job);
+#else
+    kernels[test_type].setup(0, arr_size);
+#endif
+}
+
+/* actual benchmark */
+/* arr_size: number of type 'long' elements in test arrays
+ * long_size: sizeof(long) cached
+ * test_type: index into kernels[]
+ *
+ * return value: elapsed time in seconds
+ */
+double worker()
+{
+    timestamp starttime, endtime;
+    struct rusage ru_start, ru_end;
+    int const count_faults = kernels[test_type].flags & KF_FAULT;
+    double te;
+    /* array size in bytes */
+
+    /* process wide, so it is set here rather than by the threads */
+    if ((kernels[test_type].flags & KF_NOTHP) && prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) != 0) {
+        err(1, "prctl(PR_SET_THP_DISABLE)");
+    }
+    if (perf_enabled) {
+        imc_start();
+    }
+    if (count_faults) {
+        getrusage(RUSAGE_SELF, &ru_start);
+    }
+#ifdef MULTITHREADED
+    probe_done = 0;
+    chunk_cursor.next = 0;
+    starttime = timer_start();
+    start_threads();
+    await_threads();
+    endtime = timer_stop();
+#else
+
+    struct kernel const *k = &kernels[test_type];
+    unsigned long r;
+    long sum = 0;
+
+    if (perf_enabled) {
+        perf_start(&thread_counters[0]);
+    }
+    starttime = timer_start();
+    for (r=0; r<repetitions; r++) {
+        sum = k->fn(0, touched_elems(k));
+    }
+    endtime = timer_stop();
+    if (perf_enabled) {
+        perf_stop(&thread_counters[0]);
+    }
+    if (sanity_check && (k->flags & KF_SUM)) {
+        if (sum != arr_a_sum) {
+            printf("expected: arr_a_sum == %12ld (%016lx)\n", arr_a_sum, arr_a_sum);
+            printf("output:          sum == %12ld (%016lx)\n", sum, sum);
+        }
+        assert(sum == arr_a_sum);
+    }
+#endif // !MULTITHREADED
+    if (perf_enabled) {
+        imc_stop();
+    }
+    if (count_faults) {
+        getrusage(RUSAGE_SELF, &ru_end);
+        nr_faults = (ru_end.ru_minflt - ru_start.ru_minflt) + (ru_end.ru_majflt - ru_start.ru_majflt);
+    }
+    if ((kernels[test_type].flags & KF_NOTHP) && prctl(PR_SET_THP_DISABLE, 0, 0, 0, 0) != 0) {
+        err(1, "prctl(PR_SET_THP_DISABLE)");
+    }
+
+    te=run_time(starttime, endtime);
+
+    return te;
+}
+
+/* find the number of kernel passes per sample (repetitions) needed for a
+ * sample to take at least min_time seconds */
+void calibrate(double min_time)
+{
+    double te;
+
+    repetitions = 1;
+    while ((te = worker()) < min_time) {
+        if (te < min_time / 100) {
+            repetitions *= 100;
+        } else {
+            repetitions = repetitions * (1.1 * min_time / te) + 1;
+        }
+    }
+}
+
+/* ------------------------------------------------------ */
+
+/* print the parameters of the current sweep point and test */
+void print_params()
+{
+    unsigned int level;
+    char buf[64];
+
+    /* the fields of the original text format come first, in its order */
+    out_field("block_size_B", "%llu", block_size);
+    out_field("array_size_B", "%llu", arr_size*sizeof(long));
+#ifdef MULTITHREADED
+    out_field("n_threads", "%lu", num_threads);
+#else
+    out_field("n_threads", "%d", 1);
+#endif
+#ifdef NUMA
+    out_field("from_numa_node", "%d", numa_node_a);
+    out_field("to_numa_node", "%d", numa_node_b);
+    out_field("cpu_numa_node", "%d", numa_node_cpu);
+    out_field("numa_distance_ram_ram", "%d", numa_distance(numa_node_a, numa_node_b));
+    out_field("numa_distance_ram_cpu", "%d", numa_distance(numa_node_a, numa_node_cpu));
+    out_field("numa_distance_cpu_ram", "%d", numa_distance(numa_node_cpu, numa_node_b));
+    out_field("from_numa_node_pct", "%.1f", numa_pct_a);
+    out_field("to_numa_node_pct", "%.1f", numa_pct_b);
+#else
+    out_na("from_numa_node");
+    out_na("to_numa_node");
+    out_na("cpu_numa_node");
+    out_na("numa_distance_ram_ram");
+    out_na("numa_distance_ram_cpu");
+    out_na("numa_distance_cpu_ram");
+    out_na("from_numa_node_pct");
+    out_na("to_numa_node_pct");
+#endif
+    out_field("repetitions", "%lu", repetitions);
+#ifdef MULTITHREADED
+    if (dynamic_schedule(&kernels[test_type])) {
+        out_str("schedule", "dynamic");
+        out_field("chunk_B", "%llu", chunk_elems * sizeof(long));
+    } else {
+        out_str("schedule", "static");
+        out_na("chunk_B");
+    }
+    print_cpus(num_threads);
+#else
+    print_cpus(1);
+#endif
+#ifdef MULTITHREADED
+    level = cache_level(num_threads);
+#else
+    level = cache_level(1);
+#endif
+    out_field("working_set_B", "%llu", working_set());
+    if (level) {
+        snprintf(buf, sizeof(buf), "L%u", level);
+        out_str("cache_level", buf);
+    } else {
+        out_str("cache_level", "DRAM");
+    }
+    out_str("alloc", alloc_names[alloc_backend]);
+    if (file_a != NULL || file_b != NULL) {
+        if (file_a != NULL) {
+            out_str("file_a", file_a);
+        } else {
+            out_na("file_a");
+        }
+        if (file_b != NULL) {
+            out_str("file_b", file_b);
+        } else {
+            out_na("file_b");
+        }
+        snprintf(buf, sizeof(buf), "%s%s", file_map_flags & MAP_SHARED ? "shared" : "private",
+                file_map_flags & MAP_POPULATE ? ",populate" : "");
+        out_str("map_flags", buf);
+    }
+    if (arr_a != NULL) {
+        out_field("page_size_a_B", "%lu", page_size_a);
+        out_field("thp_a_pct", "%.1f", thp_pct_a);
+    } else {
+        out_na("page_size_a_B");
+        out_na("thp_a_pct");
+    }
+    if (arr_b != NULL) {
+        out_field("page_size_b_B", "%lu", page_size_b);
+        out_field("thp_b_pct", "%.1f", thp_pct_b);
+    } else {
+        out_na("page_size_b_B");
+        out_na("thp_b_pct");
+    }
+    if (kernels[test_type].flags & KF_STRIDE) {
+        out_field("stride_B", "%lu", access_stride);
+    }
+    if (kernels[test_type].flags & KF_PREFETCH) {
+        out_field("prefetch_B", "%lu", prefetch_dist);
+    }
+    if (kernels[test_type].flags & KF_MIX) {
+        snprintf(buf, sizeof(buf), "%lu:%lu", mix_read, mix_write);
+        out_str("read_write_ratio", buf);
+    }
+#ifdef MULTITHREADED
+    if (load_test >= 0 && kernels[test_type].chase_stride) {
+        out_str("load_test", kernels[load_test].name);
+        out_field("inject_delay", "%lu", inject_delay);
+    }
+#endif
+}
+
+int cmp_double(void const *a, void const *b)
+{
+    double const x = *(double const *)a, y = *(double const *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of n sorted values */
+double percentile(double const *sorted, unsigned int n, double p)
+{
+    unsigned int rank = ceil(p / 100 * n);
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+/* two-sided 95% quantile of Student's t distribution */
+double t95(unsigned int dof)
+{
+    static double const table[] = {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+        2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+        2.042,
+    };
+
+    if (dof < sizeof(table) / sizeof(table[0])) {
+        return table[dof];
+    }
+    return 1.960 + 2.4 / dof;
+}
+
+/* half width of the 95% confidence interval of the mean, relative to the
+ * mean, for n values with the given mean and sum of squared deviations */
+double ci95_rel(unsigned int n, double mean, double m2)
+{
+    if (n < 2) {
+        return INFINITY;
+    }
+    return t95(n - 1) * sqrt(m2 / (n - 1) / n) / mean;
+}
+
+/* print statistics over the samples of one test and sweep point.
+ * samples: elapsed time of each sample in seconds, reordered in place
+ * mt: amount of data per sample in MiB
+ * outlier_mad: if > 0, samples whose throughput is more than this many
+ *              median absolute deviations from the median are dropped
+ * stop: why sampling ended
+ */
+void print_summary(double *samples, unsigned int n, double mt, double outlier_mad, char const *stop)
+{
+    double median, mad, mean = 0, var = 0, te_sum = 0;
+    unsigned int i, kept = 0;
+
+    /* throughput of each sample, sorted */
+    for (i = 0; i < n; i++) {
+        samples[i] = mt / samples[i];
+    }
+    qsort(samples, n, sizeof(double), cmp_double);
+
+    if (outlier_mad > 0) {
+        double *dev = malloc(n * sizeof(double));
+        median = percentile(samples, n, 50);
+        for (i = 0; i < n; i++) {
+            dev[i] = fabs(samples[i] - median);
+        }
+        qsort(dev, n, sizeof(double), cmp_double);
+        mad = percentile(dev, n, 50);
+        free(dev);
+        for (i = 0; i < n; i++) {
+            if (fabs(samples[i] - median) <= outlier_mad * mad) {
+                samples[kept++] = samples[i];
+            }
+        }
+    } else {
+        kept = n;
+    }
+
+    for (i = 0; i < kept; i++) {
+        mean += samples[i];
+        te_sum += mt / samples[i];
+    }
+    mean /= kept;
+    for (i = 0; i < kept; i++) {
+        var += (samples[i] - mean) * (samples[i] - mean);
+    }
+    var = kept > 1 ? var / (kept - 1) : 0;
+
+    out_sep();
+    out_field("samples", "%u", kept);
+    out_field("outliers", "%u", n - kept);
+    out_double("mean_MiBps", mean);
+    out_double("min_MiBps", samples[0]);
+    out_double("max_MiBps", samples[kept - 1]);
+    out_double("median_MiBps", percentile(samples, kept, 50));
+    out_double("p5_MiBps", percentile(samples, kept, 5));
+    out_double("p95_MiBps", percentile(samples, kept, 95));
+    out_double("p99_MiBps", percentile(samples, kept, 99));
+    out_double("stddev_MiBps", sqrt(var));
+    out_double("cv", sqrt(var) / mean);
+    out_double("ci95_rel", ci95_rel(kept, mean, var * (kept - 1)));
+    out_double("avg_time_s", te_sum / kept);
+    out_double("avg_throughput_MiBps", mt * kept / te_sum);
+    out_str("stop", stop);
+    out_end();
+}
+
+/* pretty print worker's output in human-readable terms */
+/* te: elapsed time in seconds
+ * mt: amount of transferred data in MiB
+ * test_type: see 'worker' above
+ *
+ * return value: -
+ */
+void printout(double te, double mt)
+{
+    struct kernel const *k = &kernels[test_type];
+
+    out_str("e_method", k->method);
+    if (k->chase_stride) {
+        /* threads chase their chains concurrently */
+        unsigned long long start = 0, stop = arr_size;
+        double probe_time = te;
+#ifdef MULTITHREADED
+        thread_range(0, k, &start, &stop);
+        if (load_test >= 0) {
+            double load_bw = 0;
+            for (unsigned long i = 1; i < num_threads; i++) {
+                /* threads with an empty slice did no work */
+                if (thread_times[i].load_bytes) {
+                    load_bw += thread_times[i].load_bytes / run_time(thread_times[i].start, thread_times[i].end);
+                }
+            }
+            probe_time = run_time(thread_times[0].start, thread_times[0].end);
+            out_double("load_MiBps", load_bw / 1024 / 1024);
+        }
+#endif
+        out_double("latency_ns", probe_time * 1e9 / repetitions / chase_links(start, stop, k->chase_stride));
+    }
+    if (k->flags & KF_MIX) {
+        double const read_share = (double)mix_read / (mix_read + mix_write);
+        out_double("read_MiBps", read_share * mt / te);
+        out_double("write_MiBps", (1 - read_share) * mt / te);
+    }
+    if (k->flags & KF_STRIDE) {
+        /* accesses less than a cache line apart share lines */
+        unsigned long line_stride = access_stride > 64 ? access_stride : 64;
+        out_double("cache_lines_per_s", (double)arr_size * sizeof(long) / line_stride * repetitions / te);
+    }
+    if (k->random_access) {
+        /* each access touches a different cache line */
+        out_field("access_size_B", "%u", k->random_access);
+        out_double("cache_lines_per_s", (double)arr_size * sizeof(long) / k->random_access * repetitions / te);
+    }
+    if (k->flags & KF_FAULT) {
+        out_field("faults", "%llu", nr_faults);
+        out_double("faults_per_s", nr_faults / te);
+    }
+    if (perf_enabled) {
+        print_counters(te, mt);
+    }
+    out_sep();
+    out_legacy_double("data_MiB", mt);
+    out_legacy_double("time_s", te);
+    out_legacy_double("throughput_MiBps", mt/te);
+    if (timer == TIMER_TSC) {
+        out_double("B_per_cycle", mt * 1024 * 1024 / (te / timer_period));
+    }
+    out_end();
+    return;
+}
+
+/* ------------------------------------------------------ */
+
+int main(int argc, char **argv)
+{
+    unsigned int long_size=0;
+    double te; /* time elapsed */
+    double *samples = NULL; /* per-sample times for the summary */
+    unsigned int i;
+    int o; /* getopt options */
+    unsigned int nr_tests;
+
+    /* options */
+
+    /* how many runs to average? */
+    unsigned int nr_loops=DEFAULT_NR_LOOPS;
+    /* untimed runs before the timed ones (-w) */
+    unsigned int nr_warmup=1;
+    /* stop once the 95% confidence interval of the mean throughput is
+     * within this relative error (-E), after at least min_loops runs (-k) */
+    double target_error=0;
+    unsigned int min_loops=3;
+    /* wall-clock budget per test and sweep point in seconds (-T) */
+    double time_budget=0;
+    /* outlier rejection threshold for the summary (-O), 0 to disable */
+    double outlier_mad=0;
+    int summary=1;
+    /* what tests to run (-t x) */
+    int tests[NR_KERNELS];
+    double data; /* MiBytes reported for a sample */
+    unsigned long *strides;
+    unsigned long *mixes; /* pairs of read and write shares */
+    unsigned int nr_mixes = 0;
+    char *opt_mix = "1:1";
+    unsigned int nr_strides = 1;
+    char *opt_stride = NULL;
+    unsigned long *prefetch_dists;
+    unsigned int nr_prefetch_dists = 1;
+    char *opt_prefetch = NULL;
+    int quiet=0; /* suppress extra messages */
+
+    /* sweep points: array sizes, thread counts and NUMA placements */
+    unsigned long long *sizes = NULL;
+    unsigned int nr_sizes = 0;
+    unsigned long long max_size = 0, min_size = 0;
+    /* minimum duration of a timed sample in seconds (-m) */
+    double min_time = 0;
+    unsigned long long max_arr_size;
+    unsigned long point, nr_points, idx;
+#ifdef MULTITHREADED
+    char *opt_threads = NULL;
+    char *opt_delay = NULL;
+    unsigned long *delays;
+    unsigned int nr_delays = 1;
+    char *opt_chunk = NULL;
+    unsigned long *chunk_sizes;
+    unsigned int nr_chunk_sizes = 1;
+    unsigned long init_threads = 0, init_shift = 0;
+    unsigned long *thread_counts;
+    unsigned int nr_thread_counts = 1;
+#endif
+#ifdef NUMA
+    char *opt_node_a = NULL, *opt_node_b = NULL, *opt_node_cpu = NULL, *opt_placement = NULL;
+    struct bitmask **masks_a, **masks_b;
+    unsigned long *cpu_nodes = NULL;
+    unsigned int nr_masks_a, nr_masks_b, nr_cpu_nodes = 1;
+    struct bitmask *bitmask_a = NULL, *bitmask_b = NULL;
+#endif
+
+    memset(tests, 0, sizeof(tests));
+    init_kernels();
+
+    while((o=getopt(argc, argv, "ha:b:c:qn:N:t:B:CSm:P:LH:l:I:Rs:M:w:AO:JE:k:T:pr:D:F:f:o:x:d:")) != EOF) {
+        switch(o) {
+            case 'h':
+                usage();
+                exit(1);
+                break;
+#ifdef NUMA
+            case 'a': /* NUMA node */
+                opt_node_a = optarg;
+                break;
+            case 'b': /* NUMA node */
+                opt_node_b = optarg;
+                break;
+            case 'c': /* NUMA node */
+                opt_node_cpu = optarg;
+                break;
+            case 'D': /* NUMA placement of the arrays */
+                opt_placement = optarg;
+                break;
+#ifdef MULTITHREADED
+            case 'L': /* NUMA-local array slices */
+                thread_placement = PLACE_LOCAL;
+                break;
+#endif
+#endif
+            case 'n': /* no. loops */
+                nr_loops=strtoul(optarg, (char **)NULL, 10);
+                break;
+#ifdef MULTITHREADED
+            case 'N': /* no. threads */
+                opt_threads = optarg;
+                break;
+            case 'l': /* loaded latency */
+                load_test = select_kernel(optarg);
+                if (kernels[load_test].setup != NULL) {
+                    printf("Error: %s cannot be used as load\n", kernels[load_test].name);
+                    exit(1);
+                }
+                break;
+            case 'I': /* injection delay */
+                opt_delay = optarg;
+                break;
+            case 'd': /* dynamic scheduling chunk size */
+                opt_chunk = optarg;
+                break;
+            case 'R': /* shared random index range */
+                random_shared = 1;
+                break;
+#endif
+            case 't': /* test to run */
+                tests[select_kernel(optarg)]=1;
+                break;
+            case 'B': /* block size in bytes*/
+                block_size=strtoull(optarg, (char **)NULL, 10);
+                if(0>=block_size) {
+                    printf("Error: what block size do you mean?\n");
+                    exit(1);
+                }
+                break;
+            case 'C':
+                sanity_check = 1;
+                break;
+            case 'p': /* performance counters */
+                perf_enabled = 1;
+                break;
+            case 'J': /* JSON lines */
+                output_json = 1;
+                quiet = 1;
+                break;
+            case 'q': /* quiet */
+                quiet=1;
+                break;
+            case 'S': /* sweep mode */
+                sweep = 1;
+                break;
+            case 'E': /* target relative error in percent */
+                target_error=strtod(optarg, (char **)NULL) / 100;
+                break;
+            case 'k': /* minimum no. loops */
+                min_loops=strtoul(optarg, (char **)NULL, 10);
+                break;
+            case 'T': /* time budget in seconds */
+                time_budget=strtod(optarg, (char **)NULL);
+                break;
+            case 'w': /* warm-up runs */
+                nr_warmup=strtoul(optarg, (char **)NULL, 10);
+                break;
+            case 'A': /* no summary */
+                summary=0;
+                break;
+            case 'O': /* outlier rejection */
+                outlier_mad=strtod(optarg, (char **)NULL);
+                break;
+            case 'M': /* read:write mix */
+                opt_mix = optarg;
+                break;
+            case 's': /* access stride in bytes */
+                opt_stride = optarg;
+                break;
+            case 'F': /* prefetch distance in bytes */
+                opt_prefetch = optarg;
+                break;
+            case 'm': /* minimum sample duration in ms */
+                min_time = strtod(optarg, (char **)NULL) / 1000;
+                break;
+            case 'r': /* timer backend */
+                for (i = 0; i < sizeof(timer_names) / sizeof(timer_names[0]); i++) {
+                    if (!strcmp(optarg, timer_names[i])) {
+                        break;
+                    }
+                }
+                if (i == sizeof(timer_names) / sizeof(timer_names[0])) {
+                    printf("Error: unknown timer '%s'\n", optarg);
+                    exit(1);
+                }
+                timer = i;
+                break;
+            case 'f': /* file mapped as input array */
+                file_a = optarg;
+                break;
+            case 'o': /* file mapped as output array */
+                file_b = optarg;
+                break;
+            case 'x': /* mmap flags of -f / -o */
+                file_map_flags = 0;
+                for (char *tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                    if (!strcmp(tok, "shared")) {
+                        file_map_flags |= MAP_SHARED;
+                    } else if (!strcmp(tok, "private")) {
+                        file_map_flags |= MAP_PRIVATE;
+                    } else if (!strcmp(tok, "populate")) {
+                        file_map_flags |= MAP_POPULATE;
+                    } else {
+                        printf("Error: unknown mmap flag '%s'\n", tok);
+                        exit(1);
+                    }
+                }
+                if ((file_map_flags & MAP_SHARED) && (file_map_flags & MAP_PRIVATE)) {
+                    printf("Error: -x takes either shared or private\n");
+                    exit(1);
+                }
+                if (!(file_map_flags & MAP_PRIVATE)) {
+                    file_map_flags |= MAP_SHARED;
+                }
+                break;
+            case 'H': /* allocation backend */
+                for (i = 0; i < sizeof(alloc_names) / sizeof(alloc_names[0]); i++) {
+                    if (!strcmp(optarg, alloc_names[i])) {
+                        break;
+                    }
+                }
+                if (i == sizeof(alloc_names) / sizeof(alloc_names[0])) {
+                    printf("Error: unknown allocation backend '%s'\n", optarg);
+                    exit(1);
+                }
+                alloc_backend = i;
+                break;
+            case 'P': /* CPU layout */
+                if (!strcmp(optarg, "compact")) {
+                    cpu_layout = LAYOUT_COMPACT;
+                } else if (!strcmp(optarg, "scatter")) {
+                    cpu_layout = LAYOUT_SCATTER;
+                } else if (!strcmp(optarg, "cores")) {
+                    cpu_layout = LAYOUT_CORES;
+                } else {
+                    cpu_layout = LAYOUT_LIST;
+                    nr_cpu_list = parse_list(optarg, &cpu_list);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    nr_tests = 0;
+    for (i = 0; i < NR_KERNELS; i++) {
+        nr_tests += tests[i];
+    }
+
+#ifdef MULTITHREADED
+    if (load_test >= 0 && nr_tests == 0) {
+        tests[find_kernel("latency")] = 1;
+        nr_tests = 1;
+    }
+#endif
+
+    /* default is to run all tests this CPU supports if no specific tests were requested */
+    if(nr_tests == 0) {
+        for (i = 0; i < NR_KERNELS; i++) {
+            if ((kernels[i].flags & KF_DEFAULT) && kernel_available(&kernels[i])) {
+                tests[i] = 1;
+                nr_tests++;
+            }
+        }
+    }
+
+    if (min_loops < 2) {
+        min_loops = 2;
+    }
+
+    if( nr_loops==0 && nr_tests != 1 ) {
+        printf("Error: nr_loops can be zero if only one test selected!\n");
+        exit(1);
+    }
+
+    if(optind>=argc) {
+        printf("Error: no array size given!\n");
+        exit(1);
+    }
+
+    /* each remaining argument is an array size or a list of array sizes */
+    for (; optind < argc; optind++) {
+        unsigned long long *list;
+        unsigned int n = parse_sizes(argv[optind], &list);
+        sizes = realloc(sizes, (nr_sizes + n) * sizeof(unsigned long long));
+        if (sizes == NULL) {
+            err(1, "realloc");
         }
-        else if (mp_status[0] < 0) {
-            printf("move_pages(arr_b) error: %d\n", mp_status[0]);
+        memcpy(sizes + nr_sizes, list, n * sizeof(unsigned long long));
+        nr_sizes += n;
+        free(list);
+    }
+    min_size = sizes[0];
+    for (i = 0; i < nr_sizes; i++) {
+        if (sizes[i] > max_size) {
+            max_size = sizes[i];
         }
-        else {
-            numa_node_b = mp_status[0];
+        if (sizes[i] < min_size) {
+            min_size = sizes[i];
         }
     }
 
-    if (numa_node_cpu != -1) {
-        if (numa_run_on_node(numa_node_cpu) == -1) {
-            perror("numa_run_on_node");
-            numa_node_cpu = -1;
+    if(0>=min_size) {
+        printf("Error: array size wrong!\n");
+        exit(1);
+    }
+
+    if (opt_stride != NULL && sweep) {
+        nr_strides = parse_list(opt_stride, &strides);
+    } else {
+        strides = malloc(sizeof(unsigned long));
+        strides[0] = opt_stride ? strtoul(opt_stride, (char **)NULL, 10) : sizeof(long);
+    }
+    for (i = 0; i < nr_strides; i++) {
+        if (strides[i] == 0 || strides[i] % sizeof(long)) {
+            printf("Error: stride must be a positive multiple of %d bytes\n", (int)sizeof(long));
+            exit(1);
+        }
+    }
+
+    if (opt_prefetch != NULL && sweep) {
+        nr_prefetch_dists = parse_list(opt_prefetch, &prefetch_dists);
+    } else {
+        prefetch_dists = malloc(sizeof(unsigned long));
+        prefetch_dists[0] = opt_prefetch ? strtoul(opt_prefetch, (char **)NULL, 10) : DEFAULT_PREFETCH_DIST;
+    }
+
+    /* read:write ratios, a comma-separated list with -S */
+    mixes = malloc(2 * sizeof(unsigned long) * (strlen(opt_mix) / 2 + 1));
+    for (char *str = opt_mix, *end; ; str = end + 1) {
+        mixes[2 * nr_mixes] = strtoul(str, &end, 10);
+        if (end == str || *end != ':') {
+            printf("Error: read:write mix must be given as <reads>:<writes>\n");
+            exit(1);
+        }
+        str = end + 1;
+        mixes[2 * nr_mixes + 1] = strtoul(str, &end, 10);
+        if (end == str || (*end != '\0' && *end != ',') || (*end == ',' && !sweep)) {
+            printf("Error: read:write mix must be given as <reads>:<writes>\n");
+            exit(1);
+        }
+        if (mixes[2 * nr_mixes] + mixes[2 * nr_mixes + 1] == 0) {
+            printf("Error: read:write mix must not be 0:0\n");
+            exit(1);
+        }
+        nr_mixes++;
+        if (*end == '\0') {
+            break;
+        }
+    }
+
+#ifdef MULTITHREADED
+    if (opt_threads != NULL && sweep) {
+        nr_thread_counts = parse_list(opt_threads, &thread_counts);
+    } else {
+        thread_counts = malloc(sizeof(unsigned long));
+        thread_counts[0] = opt_threads ? strtoul(opt_threads, (char **)NULL, 10) : 1;
+    }
+    for (i = 0; i < nr_thread_counts; i++) {
+        if (thread_counts[i] == 0) {
+            printf("Error: number of threads must be positive\n");
+            exit(1);
+        }
+        if (thread_counts[i] > max_threads) {
+            max_threads = thread_counts[i];
+        }
+        if (load_test >= 0 && thread_counts[i] < 2) {
+            printf("Error: loaded latency (-l) needs at least two threads\n");
+            exit(1);
+        }
+    }
+    if (opt_delay != NULL && sweep) {
+        nr_delays = parse_list(opt_delay, &delays);
+    } else {
+        delays = malloc(sizeof(unsigned long));
+        delays[0] = opt_delay ? strtoul(opt_delay, (char **)NULL, 10) : 0;
+    }
+    if (opt_chunk != NULL && sweep) {
+        nr_chunk_sizes = parse_list(opt_chunk, &chunk_sizes);
+    } else {
+        chunk_sizes = malloc(sizeof(unsigned long));
+        chunk_sizes[0] = opt_chunk ? strtoul(opt_chunk, (char **)NULL, 10) : 0;
+    }
+    for (i = 0; i < nr_chunk_sizes; i++) {
+        if (chunk_sizes[i] % 64) {
+            printf("Error: chunk size must be a multiple of 64 bytes\n");
+            exit(1);
+        }
+    }
+#endif
+
+#ifdef NUMA
+    if (opt_placement == NULL) {
+        /* -L or none */
+    } else if (!strcmp(opt_placement, "interleave")) {
+        thread_placement = PLACE_INTERLEAVE;
+        array_policy = MPOL_INTERLEAVE;
+    } else if (!strcmp(opt_placement, "local")) {
+        thread_placement = PLACE_LOCAL;
+    } else if (!strcmp(opt_placement, "matrix")) {
+        struct bitmask *mems = numa_get_mems_allowed();
+        thread_placement = PLACE_MATRIX;
+        place_nodes = calloc(numa_max_node() + 1, sizeof(unsigned long));
+        for (i = 0; i <= (unsigned int)numa_max_node(); i++) {
+            if (numa_bitmask_isbitset(mems, i)) {
+                place_nodes[nr_place_nodes++] = i;
+            }
+        }
+        numa_free_nodemask(mems);
+        if (opt_node_cpu != NULL) {
+            printf("Error: -D matrix cannot be combined with -c\n");
+            exit(1);
         }
+        /* spread the threads over the nodes */
+        if (cpu_layout == LAYOUT_NONE) {
+            cpu_layout = LAYOUT_SCATTER;
+        }
+    } else {
+        thread_placement = PLACE_NODES;
+        nr_place_nodes = parse_list(opt_placement, &place_nodes);
+        for (i = 0; i < nr_place_nodes; i++) {
+            if (place_nodes[i] > (unsigned long)numa_max_node()) {
+                printf("Error: NUMA node %lu does not exist\n", place_nodes[i]);
+                exit(1);
+            }
+        }
+    }
+#ifndef MULTITHREADED
+    if (thread_placement >= PLACE_LOCAL) {
+        printf("Error: -D %s needs the multithreaded build\n", opt_placement);
+        exit(1);
+    }
+#endif
+    if (thread_placement != PLACE_NONE && (opt_node_a != NULL || opt_node_b != NULL)) {
+        printf("Error: -D and -L cannot be combined with -a or -b\n");
+        exit(1);
+    }
+    nr_masks_a = parse_nodes(opt_node_a, &masks_a);
+    nr_masks_b = parse_nodes(opt_node_b, &masks_b);
+    if (thread_placement == PLACE_INTERLEAVE) {
+        masks_a[0] = masks_b[0] = numa_get_mems_allowed();
+    }
+    if (opt_node_cpu != NULL && sweep) {
+        nr_cpu_nodes = parse_list(opt_node_cpu, &cpu_nodes);
+    } else if (opt_node_cpu != NULL) {
+        numa_node_cpu = strtoul(opt_node_cpu, (char **)NULL, 10);
+    }
+#endif
+
+    nr_points = nr_sizes * nr_strides * nr_mixes * nr_prefetch_dists;
+#ifdef MULTITHREADED
+    nr_points *= nr_delays * nr_chunk_sizes * nr_thread_counts;
+#endif
+#ifdef NUMA
+    nr_points *= nr_masks_a * nr_masks_b * nr_cpu_nodes;
+    if (thread_placement == PLACE_MATRIX) {
+        nr_points *= nr_place_nodes;
     }
 #endif
 
+    if (nr_loops == 0 && nr_points > 1) {
+        printf("Error: nr_loops can be zero only if a single array size / placement is selected!\n");
+        exit(1);
+    }
+
     /* ------------------------------------------------------ */
-    if(!quiet) {
-        printf("Getting down to business... Doing %d runs per test.\n", nr_loops);
+
+    long_size=sizeof(long); /* the size of long on this platform */
+    /* arrays are allocated once for the largest sweep point and reused */
+    max_arr_size=max_size/long_size; /* how many longs then in one array? */
+    arr_size=max_arr_size;
+
+    unsigned int uses_block = 0, uses_fault = 0, reads = 0, writes = 0;
+    for (i = 0; i < NR_KERNELS; i++) {
+        if (tests[i]) {
+            uses_block |= kernels[i].flags & KF_BLOCK;
+            uses_fault |= kernels[i].flags & KF_FAULT;
+            reads |= kernels[i].reads;
+            writes |= kernels[i].writes;
+        }
+    }
+#ifdef MULTITHREADED
+    if (load_test >= 0) {
+        reads |= kernels[load_test].reads;
+        writes |= kernels[load_test].writes;
+    }
+#endif
+
+    /* glibc raises its mmap threshold when an mmapped chunk is freed, after
+     * which fault-calloc and fault-memset would get already faulted-in heap
+     * memory. Fixed thresholds keep every allocation of a page or more a
+     * fresh mmap. */
+    if (uses_fault) {
+        long page = sysconf(_SC_PAGESIZE);
+        if (mallopt(M_MMAP_THRESHOLD, page) != 1 || mallopt(M_TRIM_THRESHOLD, page) != 1) {
+            warnx("mallopt failed, the malloc fault tests may reuse memory");
+        }
     }
 
+    for (i = 0; i < NR_KERNELS; i++) {
+        if (!tests[i] || !kernels[i].chase_stride) {
+            continue;
+        }
+        for (unsigned int s = 0; s < nr_sizes; s++) {
 #ifdef MULTITHREADED
-    if (sem_init(&start_sem, 0, 0) != 0) {
-        err(1, "sem_init");
+            for (unsigned int t = 0; t < nr_thread_counts; t++) {
+                check_chase_size(kernels[i].name, sizes[s], thread_counts[t], kernels[i].chase_stride);
+            }
+#else
+            check_chase_size(kernels[i].name, sizes[s], 1, kernels[i].chase_stride);
+#endif
+        }
+    }
+
+    if(min_size < block_size && uses_block) {
+        printf("Error: array size larger than block size (%llu bytes)!\n", block_size);
+        exit(1);
+    }
+
+    if(!quiet) {
+        printf("Long uses %d bytes. ", long_size);
+        if(uses_block) {
+            printf("Using %lld bytes as blocks for memcpy block copy test.\n", block_size);
+        }
+        if (nr_points > 1) {
+            printf("Sweeping over %lu parameter combinations.\n", nr_points);
+        }
     }
-    if (sem_init(&stop_sem, 0, 0) != 0) {
-        err(1, "sem_init");
+
+    detect_caches();
+    if (sched_getaffinity(0, sizeof(cpus_allowed), &cpus_allowed) != 0) {
+        err(1, "sched_getaffinity");
     }
-    if (sem_init(&sync_sem, 0, 0) != 0) {
-        err(1, "sem_init");
+#ifdef MULTITHREADED
+    main_cpus = CPU_COUNT(&cpus_allowed);
+#else
+    thread_cpu = calloc(1, sizeof(int));
+#endif
+    if (!quiet) {
+        for (i = 1; i <= MAX_CACHE_LEVEL; i++) {
+            if (cache_size[i]) {
+                printf("L%d cache: %llu KiB\n", i, cache_size[i] / 1024);
+            }
+        }
     }
-    threads = calloc(num_threads, sizeof(pthread_t));
-    if (sanity_check) {
-        partial_sum = calloc(num_threads, sizeof(long));
+
+#ifdef NUMA
+    bitmask_a = masks_a[0];
+    bitmask_b = masks_b[0];
+#endif
+    if ((reads | writes) & ARR_A) {
+        if (!quiet) {
+            printf("Allocating %lld elements = %.3f MiB of input memory.\n", arr_size, (double)arr_size*long_size / 1024 / 1024);
+        }
+        arr_a = file_a ? map_file(file_a, &file_maps[0]) : make_array();
+#ifdef NUMA
+        bind_array(arr_a, arr_size, bitmask_a, array_policy, 0);
+#endif
     }
-    for (i=0; i < num_threads; i++) {
-        if (sanity_check) {
-            partial_sum[i] = 0;
+    if ((reads | writes) & ARR_B) {
+        if (!quiet) {
+            printf("Allocating %lld elements = %.3f MiB of output memory.\n", arr_size, (double)arr_size*long_size / 1024 / 1024);
         }
+        arr_b = file_b ? map_file(file_b, &file_maps[1]) : make_array();
+#ifdef NUMA
+        bind_array(arr_b, arr_size, bitmask_b, array_policy, 0);
+#endif
+    }
+    /* the third STREAM array shares the placement of the output array */
+    if ((reads | writes) & ARR_C) {
+        if (!quiet) {
+            printf("Allocating %lld elements = %.3f MiB of additional output memory.\n", arr_size, (double)arr_size*long_size / 1024 / 1024);
+        }
+        arr_c=make_array();
+#ifdef NUMA
+        bind_array(arr_c, arr_size, bitmask_b, array_policy, 0);
+#endif
+    }
+
+    timer_init();
+    if (output_json) {
+        print_meta();
+    }
+    if (perf_enabled) {
+#ifdef MULTITHREADED
+        thread_counters = aligned_alloc(64, max_threads * sizeof(struct counters));
+        memset(thread_counters, 0, max_threads * sizeof(struct counters));
+#else
+        thread_counters = aligned_alloc(64, sizeof(struct counters));
+        memset(thread_counters, 0, sizeof(struct counters));
+#endif
+        imc_open();
+    }
+    if (summary && nr_loops > 0) {
+        samples = malloc(nr_loops * sizeof(double));
+    }
+
+    /* ------------------------------------------------------ */
+    if(!quiet) {
+        printf("Getting down to business... Doing %d runs per test.\n", nr_loops);
+    }
+
+#ifdef MULTITHREADED
+    threads = calloc(max_threads, sizeof(pthread_t));
+    thread_cpu = calloc(max_threads, sizeof(int));
+    thread_times = aligned_alloc(64, max_threads * sizeof(struct thread_time));
+    if (threads == NULL || thread_times == NULL) {
+        err(1, "calloc");
+    }
+    partial_sum = calloc(max_threads, sizeof(long));
+#ifdef NUMA
+    thread_cpu_node = malloc(max_threads * sizeof(int));
+    thread_mem_node = malloc(max_threads * sizeof(int));
+    for (i = 0; i < max_threads; i++) {
+        thread_cpu_node[i] = thread_mem_node[i] = -1;
+    }
+#endif
+    for (i=0; i < max_threads; i++) {
         if (pthread_create(&threads[i], NULL, thread_worker, (void*)(unsigned long)i) != 0) {
             err(1, "pthread_create");
         }
     }
 #endif
 
-    /* run all tests requested, the proper number of times */
-    for(test_type=0; test_type<MAX_TESTS; test_type++) {
-        te_sum=0;
-        if(tests[test_type]) {
-            for (i=0; nr_loops==0 || i<nr_loops; i++) {
-                te=worker();
-                te_sum+=te;
-                if (test_type == TEST_MEMCPY) {
-                    printf("[::] memcpy");
-                } else if (test_type == TEST_PLAIN) {
-                    printf("[::] copy");
-                } else if (test_type == TEST_MCBLOCK) {
-                    printf("[::] mcblock");
-                } else if (test_type == TEST_AVX512) {
-                    printf("[::] copy-avx512");
-                } else if (test_type == TEST_READ_PLAIN) {
-                    printf("[::] read");
-                } else if (test_type == TEST_WRITE_PLAIN) {
-                    printf("[::] write");
-                } else if (test_type == TEST_READ_AVX512) {
-                    printf("[::] read-avx512");
-                } else if (test_type == TEST_WRITE_AVX512) {
-                    printf("[::] write-avx512");
-                }
-                printf(" | block_size_B=%llu array_size_B=%llu ", block_size, arr_size*long_size);
+    /* the array size varies fastest, followed by stride, read:write mix,
+     * prefetch distance, injection delay, chunk size, thread count, CPU node and output / input memory
+     * node. Migrating memory is the most expensive step, so it happens
+     * least often. */
+    for (point = 0; point < nr_points; point++) {
+        idx = point;
+        arr_size = sizes[idx % nr_sizes] / long_size;
+        idx /= nr_sizes;
+        access_stride = strides[idx % nr_strides];
+        idx /= nr_strides;
+        mix_read = mixes[2 * (idx % nr_mixes)];
+        mix_write = mixes[2 * (idx % nr_mixes) + 1];
+        idx /= nr_mixes;
+        prefetch_dist = prefetch_dists[idx % nr_prefetch_dists];
+        idx /= nr_prefetch_dists;
 #ifdef MULTITHREADED
-                printf("n_threads=%ld ", num_threads);
-#else
-                printf("n_threads=1 ");
+        inject_delay = delays[idx % nr_delays];
+        idx /= nr_delays;
+        chunk_elems = chunk_sizes[idx % nr_chunk_sizes] / sizeof(long);
+        idx /= nr_chunk_sizes;
+#endif
+        arr_a_sum = 0xaa * (long)arr_size;
+#ifdef MULTITHREADED
+        if (thread_counts[idx % nr_thread_counts] != num_threads) {
+            set_num_threads(thread_counts[idx % nr_thread_counts]);
+        }
+        idx /= nr_thread_counts;
 #endif
 #ifdef NUMA
-                printf("from_numa_node=%d to_numa_node=%d cpu_numa_node=%d numa_distance_ram_ram=%d numa_distance_ram_cpu=%d numa_distance_cpu_ram=%d ", numa_node_a, numa_node_b, numa_node_cpu, numa_distance(numa_node_a, numa_node_b), numa_distance(numa_node_a, numa_node_cpu), numa_distance(numa_node_cpu, numa_node_b));
+        if (cpu_nodes != NULL) {
+            if ((int)cpu_nodes[idx % nr_cpu_nodes] != numa_node_cpu) {
+                numa_node_cpu = cpu_nodes[idx % nr_cpu_nodes];
+                run_on_node(numa_node_cpu);
+            }
+        } else if (point == 0 && numa_node_cpu != -1) {
+            run_on_node(numa_node_cpu);
+        }
+        idx /= nr_cpu_nodes;
+        if (masks_b[idx % nr_masks_b] != bitmask_b) {
+            bitmask_b = masks_b[idx % nr_masks_b];
+            bind_array(arr_b, max_arr_size, bitmask_b, MPOL_BIND, MPOL_MF_MOVE | MPOL_MF_STRICT);
+            bind_array(arr_c, max_arr_size, bitmask_b, MPOL_BIND, MPOL_MF_MOVE | MPOL_MF_STRICT);
+            numa_node_b = array_node(arr_b, max_arr_size, "move_pages(arr_b)", &numa_pct_b);
+            page_info(arr_b, &page_size_b, &thp_pct_b);
+        }
+        idx /= nr_masks_b;
+        if (masks_a[idx % nr_masks_a] != bitmask_a) {
+            bitmask_a = masks_a[idx % nr_masks_a];
+            bind_array(arr_a, max_arr_size, bitmask_a, MPOL_BIND, MPOL_MF_MOVE | MPOL_MF_STRICT);
+            numa_node_a = array_node(arr_a, max_arr_size, "move_pages(arr_a)", &numa_pct_a);
+            page_info(arr_a, &page_size_a, &thp_pct_a);
+        }
+        idx /= nr_masks_a;
+        if (thread_placement == PLACE_MATRIX) {
+            place_shift = idx % nr_place_nodes;
+        }
+#endif
+        if (cpu_layout != LAYOUT_NONE) {
+#ifdef MULTITHREADED
+            pin_threads(num_threads);
+#else
+            pin_threads(1);
+#endif
+        }
+
+        /* populate the arrays once all threads are in place. With -L, each
+         * thread's share is re-placed whenever the partitioning changes. */
+#ifdef MULTITHREADED
+        if (point == 0 || (thread_placement >= PLACE_LOCAL &&
+                    (arr_size != init_elems || num_threads != init_threads || place_shift != init_shift))) {
+            init_threads = num_threads;
+            init_shift = place_shift;
 #else
-                printf("from_numa_node=X to_numa_node=X cpu_numa_node=X numa_distance_ram_ram=X numa_distance_ram_cpu=X numa_distance_cpu_ram=X ");
+        if (point == 0) {
+#endif
+            long sum = init_array(arr_a, point ? arr_size : max_arr_size);
+            if (arr_size == init_elems) {
+                arr_a_sum = sum;
+            }
+            init_array(arr_b, point ? arr_size : max_arr_size);
+            init_array(arr_c, point ? arr_size : max_arr_size);
+#ifdef NUMA
+            numa_node_a = array_node(arr_a, init_elems, "move_pages(arr_a)", &numa_pct_a);
+            numa_node_b = array_node(arr_b, init_elems, "move_pages(arr_b)", &numa_pct_b);
+#endif
+            page_info(arr_a, &page_size_a, &thp_pct_a);
+            page_info(arr_b, &page_size_b, &thp_pct_b);
+        }
+
+        /* run all tests requested, the proper number of times */
+        for(test_type=0; test_type<NR_KERNELS; test_type++) {
+            if(tests[test_type]) {
+                if (kernels[test_type].setup != NULL) {
+                    setup_kernel();
+                }
+                if (min_time > 0) {
+                    calibrate(min_time);
+                }
+                /* bytes actually touched, the arrays may end in a partial
+                 * cache line */
+                data = (double)touched_elems(&kernels[test_type]) * sizeof(long) / 1024 / 1024 *
+                    kernels[test_type].data_factor * repetitions;
+                if (kernels[test_type].flags & KF_STRIDE) {
+                    data = data * sizeof(long) / access_stride;
+                }
+                for (i=0; i<nr_warmup; i++) {
+                    worker();
+                }
+                /* running mean and squared deviations (Welford) of the
+                 * throughput, for stopping on convergence */
+                double bw_mean = 0, bw_m2 = 0, delta;
+                char const *stop = "runs";
+                timestamp test_start = timer_start();
+                for (i=0; nr_loops==0 || i<nr_loops; i++) {
+                    te=worker();
+                    if (samples != NULL) {
+                        samples[i] = te;
+                    }
+                    delta = data / te - bw_mean;
+                    bw_mean += delta / (i + 1);
+                    bw_m2 += delta * (data / te - bw_mean);
+#ifdef MULTITHREADED
+                    if (sanity_check && (kernels[test_type].flags & KF_SUM)) {
+                        long tmp = 0, expected = arr_a_sum;
+                        for (unsigned int j=0; j < num_threads; j++) {
+                            tmp += partial_sum[j];
+                        }
+                        /* chunks of all repetitions are summed up */
+                        if (dynamic_schedule(&kernels[test_type])) {
+                            expected = (long)((unsigned long)arr_a_sum * repetitions);
+                        }
+                        if (tmp != expected) {
+                            printf("expected:  arr_a_sum == %12ld (%016lx)\n", expected, expected);
+                            printf("output: sum(partial) == %12ld (%016lx)\n", tmp, tmp);
+                        }
+                        assert(tmp == expected);
+                    }
+#endif
+                    out_begin("result", kernels[test_type].name, "sample");
+                    print_params();
+#ifdef MULTITHREADED
+                    print_thread_times(data);
 #endif
-                printout(te, mt);
+                    printout(te, data);
+#if defined(MULTITHREADED) && defined(NUMA)
+                    if (thread_placement == PLACE_MATRIX) {
+                        print_matrix(kernels[test_type].name, data);
+                    }
+#endif
+                    if (target_error > 0 && i + 1 >= min_loops && ci95_rel(i + 1, bw_mean, bw_m2) <= target_error) {
+                        stop = "converged";
+                        i++;
+                        break;
+                    }
+                    if (time_budget > 0 && elapsed(test_start, timer_stop()) >= time_budget) {
+                        stop = "time_budget";
+                        i++;
+                        break;
+                    }
+                }
+                if (samples != NULL) {
+                    out_begin("result", kernels[test_type].name, "summary");
+                    print_params();
+                    print_summary(samples, i, data, outlier_mad, stop);
+                }
+                /* restore the contents the other tests expect */
+                if (kernels[test_type].setup != NULL) {
+                    init_array(arr_a, arr_size);
+                }
             }
         }
     }
 
 #ifdef MULTITHREADED
+    pthread_mutex_lock(&pool_mutex);
     done = 1;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&pool_mutex);
     start_threads();
-    for (i=0; i < num_threads; i++) {
+    for (i=0; i < max_threads; i++) {
         if (pthread_join(threads[i], NULL) != 0) {
             err(1, "pthread_join");
         }
     }
-    if (sanity_check && (tests[TEST_READ_PLAIN] || tests[TEST_READ_AVX512])) {
-        long tmp = 0;
-        for (i=0; i < num_threads; i++) {
-            tmp += partial_sum[i];
-        }
-        if (tmp != arr_a_sum) {
-            printf("expected:  arr_a_sum == %12ld (%016lx)\n", arr_a_sum, arr_a_sum);
-            printf("output: sum(partial) == %12ld (%016lx)\n", tmp, tmp);
-        }
-        assert(tmp == arr_a_sum);
-    }
 #endif
 
-    free(arr_a);
-    free(arr_b);
+    free_array(arr_a, max_arr_size);
+    free_array(arr_b, max_arr_size);
+    free_array(arr_c, max_arr_size);
+    free(samples);
     return 0;
 }
-